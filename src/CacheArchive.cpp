@@ -0,0 +1,280 @@
+#include "CacheArchive.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#include <filesystem>
+
+#include "WPCommon.hpp"
+#include "Fs/BinaryReader.h"
+#include "Fs/MemBinaryStream.h"
+#include "Fs/PhysicalFs.h"
+#include "Fs/SpanBinaryStream.h"
+#include "Utils/Logging.h"
+
+#define ARCHIVE_MOUNT "/cache"
+#define ARCHIVE_DATA  "data"
+#define ARCHIVE_INDEX "index"
+
+using namespace wallpaper;
+
+/*
+    index
+    CARC0001
+    u32 clock, entry count
+    entry: u32 key size, key, u32 offset, size, used
+    data, records back to back
+    record: u32 key size, key, u32 size, content
+*/
+
+namespace
+{
+// kept after a compaction, of max_bytes
+constexpr usize COMPACT_KEEP_PERCENT { 75 };
+
+usize RecordSize(std::string_view key, usize size) { return 4 + key.size() + 4 + size; }
+
+void WriteRecord(fs::IBinaryStreamW& file, std::string_view key,
+                 std::span<const std::byte> content) {
+    file.WriteUint32((u32)key.size());
+    file.Write(key.data(), key.size());
+    file.WriteUint32((u32)content.size());
+    file.Write(content.data(), content.size());
+}
+} // namespace
+
+CacheArchive::CacheArchive(std::string_view cache_path, std::string_view name, usize max_bytes)
+    : m_dir(std::string(ARCHIVE_MOUNT "/") + std::string(name)), m_max_bytes(max_bytes) {
+    std::unique_lock lock(m_mutex);
+    if (! m_vfs.Mount(ARCHIVE_MOUNT, fs::CreatePhysicalFs(cache_path, true), "cache", true)) return;
+    load();
+}
+
+CacheArchive::~CacheArchive() { Commit(); }
+
+std::shared_ptr<CacheArchive> CacheArchive::Shared(std::string_view cache_path,
+                                                   std::string_view name, usize max_bytes) {
+    static std::mutex                                     mutex;
+    static Map<std::string, std::weak_ptr<CacheArchive>> archives;
+
+    std::error_code ec;
+    auto            dir = std::filesystem::absolute(std::filesystem::path(cache_path) / name, ec)
+                   .lexically_normal()
+                   .string();
+    if (ec) return nullptr;
+
+    std::unique_lock lock(mutex);
+    if (auto archive = archives[dir].lock(); archive) return archive;
+    auto archive = std::make_shared<CacheArchive>(cache_path, name, max_bytes);
+    if (! archive->m_vfs.IsMounted("cache")) return nullptr;
+    archives[dir] = archive;
+    return archive;
+}
+
+std::string CacheArchive::path(std::string_view name) const {
+    return m_dir + "/" + std::string(name);
+}
+
+void CacheArchive::mapData() {
+    m_data.reset();
+    m_data_end = 0;
+    if (! m_vfs.Contains(path(ARCHIVE_DATA))) return;
+    m_data = m_vfs.OpenMapped(path(ARCHIVE_DATA));
+    if (m_data) m_data_end = m_data->Data().size();
+}
+
+void CacheArchive::load() {
+    mapData();
+    if (! m_vfs.Contains(path(ARCHIVE_INDEX))) return;
+    auto pfile = m_vfs.OpenMapped(path(ARCHIVE_INDEX));
+    if (! pfile) return;
+    fs::BinaryReader file(pfile->Data());
+    if (ReadCacheArchiveVesion(file) != 1) {
+        LOG_ERROR("cache archive \"%s\" is broken", m_dir.c_str());
+        return;
+    }
+    m_clock   = file.ReadUint32() + 1;
+    u32 count = file.ReadUint32();
+    for (u32 i = 0; i < count && file.ok(); i++) {
+        auto  key   = file.ReadBytes(file.ReadUint32());
+        Entry entry;
+        entry.offset = file.ReadUint32();
+        entry.size   = file.ReadUint32();
+        entry.used   = file.ReadUint32();
+        if (! file.ok()) break;
+        std::string_view skey { (const char*)key.data(), key.size() };
+        // data was replaced without the index, or is shorter
+        if (! inData(skey, entry)) continue;
+        m_entries.insert_or_assign(std::string(skey), entry);
+    }
+}
+
+bool CacheArchive::inData(std::string_view key, const Entry& entry) const {
+    usize size = RecordSize(key, entry.size);
+    return size <= m_data_end && entry.offset <= m_data_end - size;
+}
+
+std::shared_ptr<fs::IBinaryStream> CacheArchive::Get(std::string_view key) {
+    std::unique_lock lock(m_mutex);
+    auto             it = m_entries.find(key);
+    if (it == m_entries.end()) return nullptr;
+    auto& entry = it->second;
+
+    std::shared_ptr<fs::IBinaryStream> res;
+    // data file removed by another writer
+    if (! entry.pending && ! m_data) {
+        m_entries.erase(it);
+        m_dirty = true;
+        return nullptr;
+    }
+    if (entry.pending) {
+        const auto& content = *entry.pending;
+        res = std::make_shared<fs::SpanBinaryStream>(
+            std::span { (const std::byte*)content.data(), content.size() }, entry.pending);
+    } else {
+        // the record repeats its key, a stale index entry doesn't match
+        fs::BinaryReader file(m_data->Data());
+        file.SeekSet(entry.offset);
+        auto rkey    = file.ReadBytes(file.ReadUint32());
+        u32  size    = file.ReadUint32();
+        auto content = file.ReadBytes(size);
+        if (! file.ok() || size != entry.size || rkey.size() != key.size() ||
+            std::memcmp(rkey.data(), key.data(), key.size()) != 0) {
+            LOG_ERROR("cache archive \"%s\" has a broken record", m_dir.c_str());
+            m_entries.erase(it);
+            m_dirty = true;
+            return nullptr;
+        }
+        res = std::make_shared<fs::SpanBinaryStream>(content, m_data);
+    }
+    m_dirty    = m_dirty || entry.used != m_clock;
+    entry.used = m_clock;
+    return res;
+}
+
+bool CacheArchive::Put(std::string_view key, std::span<const std::byte> content) {
+    std::unique_lock lock(m_mutex);
+    if (m_entries.contains(key)) return true;
+
+    usize record_size = RecordSize(key, content.size());
+    if (m_data_end + record_size > std::numeric_limits<u32>::max()) return false;
+    if (! m_append) m_append = m_vfs.OpenAppend(path(ARCHIVE_DATA));
+    if (! m_append) return false;
+    WriteRecord(*m_append, key, content);
+
+    auto pending = std::make_shared<std::vector<uint8_t>>((const uint8_t*)content.data(),
+                                                          (const uint8_t*)content.data() +
+                                                              content.size());
+    m_entries.insert_or_assign(std::string(key),
+                               Entry { .offset  = (u32)m_data_end,
+                                       .size    = (u32)content.size(),
+                                       .used    = m_clock,
+                                       .pending = std::move(pending) });
+    m_data_end += record_size;
+    m_dirty = true;
+    return true;
+}
+
+bool CacheArchive::Commit() {
+    std::unique_lock lock(m_mutex);
+    if (! m_dirty) return true;
+    // closed to flush the appended records before mapping them
+    m_append.reset();
+
+    if (m_data_end > m_max_bytes) {
+        if (! compact()) return false;
+    } else {
+        usize end = m_data_end;
+        mapData();
+        // appended or compacted by another process, or the appends failed
+        // records appended here may be at other offsets, loaded ones are checked again by Get
+        if (m_data_end != end) {
+            LOG_INFO("cache archive \"%s\" changed by another writer", m_dir.c_str());
+            std::erase_if(m_entries, [this](const auto& el) {
+                return el.second.pending || ! inData(el.first, el.second);
+            });
+        }
+        for (auto& [key, entry] : m_entries) entry.pending.reset();
+    }
+    if (! writeIndex()) return false;
+    m_dirty = false;
+    return true;
+}
+
+bool CacheArchive::compact() {
+    struct Kept {
+        const std::string*         key;
+        Entry*                     entry;
+        std::span<const std::byte> content;
+    };
+    std::vector<Kept> kept;
+    kept.reserve(m_entries.size());
+    for (auto& [key, entry] : m_entries) {
+        std::span<const std::byte> content;
+        if (entry.pending) {
+            content = { (const std::byte*)entry.pending->data(), entry.pending->size() };
+        } else if (m_data) {
+            content = m_data->Data().subspan(entry.offset + RecordSize(key, 0), entry.size);
+        }
+        kept.push_back({ &key, &entry, content });
+    }
+    // most recently used first
+    std::sort(kept.begin(), kept.end(), [](const Kept& a, const Kept& b) {
+        return a.entry->used > b.entry->used;
+    });
+
+    usize limit = m_max_bytes / 100 * COMPACT_KEEP_PERCENT;
+    usize total { 0 };
+    usize count { 0 };
+    for (; count < kept.size(); count++) {
+        usize size = RecordSize(*kept[count].key, kept[count].content.size());
+        if (total + size > limit) break;
+        total += size;
+    }
+    kept.resize(count);
+
+    StringHashMap<Entry> entries;
+    auto                 tmp_path = fs::TempPath(path(ARCHIVE_DATA));
+    {
+        auto file = m_vfs.OpenW(tmp_path);
+        if (! file) return false;
+        usize offset { 0 };
+        for (const auto& k : kept) {
+            WriteRecord(*file, *k.key, k.content);
+            entries[*k.key] = Entry { .offset  = (u32)offset,
+                                      .size    = (u32)k.content.size(),
+                                      .used    = k.entry->used,
+                                      .pending = {} };
+            offset += RecordSize(*k.key, k.content.size());
+        }
+    }
+    if (! m_vfs.Rename(tmp_path, path(ARCHIVE_DATA))) return false;
+
+    LOG_INFO("cache archive \"%s\": compacted %zu KiB to %zu KiB",
+             m_dir.c_str(),
+             m_data_end / 1024u,
+             total / 1024u);
+    m_entries = std::move(entries);
+    mapData();
+    return true;
+}
+
+bool CacheArchive::writeIndex() {
+    auto tmp_path = fs::TempPath(path(ARCHIVE_INDEX));
+    {
+        auto file = m_vfs.OpenW(tmp_path);
+        if (! file) return false;
+        WriteCacheArchiveVesion(*file, 1);
+        file->WriteUint32(m_clock);
+        file->WriteUint32((u32)m_entries.size());
+        for (const auto& [key, entry] : m_entries) {
+            file->WriteUint32((u32)key.size());
+            file->Write(key.data(), key.size());
+            file->WriteUint32(entry.offset);
+            file->WriteUint32(entry.size);
+            file->WriteUint32(entry.used);
+        }
+    }
+    return m_vfs.Rename(tmp_path, path(ARCHIVE_INDEX));
+}
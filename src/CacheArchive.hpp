@@ -0,0 +1,71 @@
+#pragma once
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+
+#include "Fs/VFS.h"
+#include "Core/NoCopyMove.hpp"
+#include "Core/MapSet.hpp"
+
+namespace wallpaper
+{
+
+// key value cache in a sub dir of the cache folder, one data file and one index
+// records are appended to the data file, the index is replaced by write then rename
+// records past the index after a crash are ignored, each record repeats its key
+// over max_bytes, least recently used records are dropped by rewriting the data file
+// thread safe, one instance per dir in the process from Shared
+// appends by other processes are detected at Commit, the records appended here are dropped
+class CacheArchive : NoCopy, NoMove {
+public:
+    // cache_path: physical cache folder, name: sub dir of the archive
+    CacheArchive(std::string_view cache_path, std::string_view name, usize max_bytes);
+    ~CacheArchive();
+
+    // the instance of the dir, shared by all scenes, nullptr if the dir can't be created
+    static std::shared_ptr<CacheArchive> Shared(std::string_view cache_path, std::string_view name,
+                                                usize max_bytes);
+
+    // view of the content, kept alive by the stream, nullptr if missing
+    std::shared_ptr<fs::IBinaryStream> Get(std::string_view key);
+    // appended to the data file, in the index after Commit
+    bool Put(std::string_view key, std::span<const std::byte> content);
+
+    // writes the index if changed, compacts the data file if over max_bytes
+    bool Commit();
+
+private:
+    struct Entry {
+        u32 offset { 0 };
+        u32 size { 0 };
+        // commit count when last read or written, for lru
+        u32 used { 0 };
+        // content not in the mapped data yet
+        std::shared_ptr<const std::vector<uint8_t>> pending;
+    };
+
+    void load();
+    void mapData();
+    bool inData(std::string_view key, const Entry&) const;
+    bool compact();
+    bool writeIndex();
+
+    std::string path(std::string_view name) const;
+
+    fs::VFS     m_vfs;
+    std::string m_dir;
+    usize       m_max_bytes;
+
+    std::mutex                          m_mutex;
+    StringHashMap<Entry>                m_entries;
+    std::shared_ptr<fs::IBinaryStream>  m_data;
+    std::shared_ptr<fs::IBinaryStreamW> m_append;
+    // end of the data file, where the next record goes
+    usize m_data_end { 0 };
+    u32   m_clock { 0 };
+    bool  m_dirty { false };
+};
+
+} // namespace wallpaper
@@ -2,6 +2,10 @@
 
 #include <map>
 #include <set>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
 
 namespace wallpaper
 {
@@ -12,6 +16,19 @@ using Map = std::map<Key, Value, std::less<>>;
 template<class Key>
 using Set = std::set<Key, std::less<>>;
 
+// hash map/set with string key, lookup by string_view without allocation
+struct StringHash {
+    using is_transparent = void;
+    std::size_t operator()(std::string_view str) const noexcept {
+        return std::hash<std::string_view> {}(str);
+    }
+};
+
+template<class Value>
+using StringHashMap = std::unordered_map<std::string, Value, StringHash, std::equal_to<>>;
+
+using StringHashSet = std::unordered_set<std::string, StringHash, std::equal_to<>>;
+
 template<class Key, class Value, class KeyLike, class Allocator>
 inline bool exists(const std::map<Key, Value, std::less<>, Allocator>& m, const KeyLike& key) noexcept {
     auto iter = m.find(key);
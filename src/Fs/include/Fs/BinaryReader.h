@@ -0,0 +1,181 @@
+#pragma once
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "Bswap.hpp"
+#include "IBinaryStream.h"
+#include "Core/NoCopyMove.hpp"
+#include "Core/Literals.hpp"
+
+namespace wallpaper
+{
+namespace fs
+{
+
+/*
+ * little endian reader over contiguous memory
+ * reading past the end never throws, it returns zeros and clears ok()
+ * check ok() once after a block of reads
+ */
+class BinaryReader {
+public:
+    BinaryReader() = default;
+    explicit BinaryReader(std::span<const std::byte> data): m_data(data) {}
+
+    bool  ok() const { return m_ok; }
+    usize Tell() const { return m_pos; }
+    usize Size() const { return m_data.size(); }
+    usize Remaining() const { return m_data.size() - m_pos; }
+
+    std::span<const std::byte> Data() const { return m_data; }
+
+    bool SeekSet(usize pos) {
+        if (pos > m_data.size()) return fail();
+        m_pos = pos;
+        return true;
+    }
+    bool Skip(usize size) {
+        if (size > Remaining()) return fail();
+        m_pos += size;
+        return true;
+    }
+
+    template<typename T>
+    T Read() {
+        static_assert(std::is_arithmetic_v<T>);
+        T x { 0 };
+        if (sizeof(T) > Remaining()) {
+            fail();
+            return x;
+        }
+        std::memcpy(&x, m_data.data() + m_pos, sizeof(T));
+        m_pos += sizeof(T);
+        return swap(x);
+    }
+
+    i64   ReadInt64() { return Read<i64>(); }
+    u64   ReadUint64() { return Read<u64>(); }
+    i32   ReadInt32() { return Read<i32>(); }
+    u32   ReadUint32() { return Read<u32>(); }
+    i16   ReadInt16() { return Read<i16>(); }
+    u16   ReadUint16() { return Read<u16>(); }
+    i8    ReadInt8() { return Read<i8>(); }
+    u8    ReadUint8() { return Read<u8>(); }
+    float ReadFloat() { return Read<float>(); }
+
+    // bulk read of trivially copyable elements, eg. std::array<float, 3>
+    template<typename T, usize N>
+    bool ReadArray(std::span<T, N> out) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        usize size = out.size_bytes();
+        if (size > Remaining()) return fail();
+        std::memcpy(out.data(), m_data.data() + m_pos, size);
+        m_pos += size;
+#ifdef WP_BIG_ENDIAN
+        if constexpr (std::is_arithmetic_v<T>) {
+            for (auto& x : out) x = swap(x);
+        }
+#endif
+        return true;
+    }
+
+    // copy up to size bytes, returns the count copied
+    usize Read(void* buffer, usize size) {
+        usize n = std::min(size, Remaining());
+        if (n > 0) std::memcpy(buffer, m_data.data() + m_pos, n);
+        m_pos += n;
+        if (n < size) m_ok = false;
+        return n;
+    }
+
+    // view of next size bytes
+    std::span<const std::byte> ReadBytes(usize size) {
+        if (size > Remaining()) {
+            fail();
+            return {};
+        }
+        auto res = m_data.subspan(m_pos, size);
+        m_pos += size;
+        return res;
+    }
+
+    // null terminated string, view into the data
+    std::string_view ReadStrView() {
+        const char* begin = (const char*)m_data.data() + m_pos;
+        usize       len   = Remaining();
+        const void* end   = std::memchr(begin, '\0', len);
+        if (end == nullptr) {
+            m_pos = m_data.size();
+            fail();
+            return { begin, len };
+        }
+        len = (usize)((const char*)end - begin);
+        m_pos += len + 1;
+        return { begin, len };
+    }
+    std::string ReadStr() { return std::string(ReadStrView()); }
+
+protected:
+    void reset(std::span<const std::byte> data) {
+        m_data = data;
+        m_pos  = 0;
+        m_ok   = true;
+    }
+
+private:
+    bool fail() {
+        m_ok  = false;
+        m_pos = m_data.size();
+        return false;
+    }
+
+    template<typename T>
+    static T swap(T x) {
+#ifdef WP_BIG_ENDIAN
+        if constexpr (sizeof(T) > 1) {
+            using U = std::conditional_t<sizeof(T) == 8,
+                                         u64,
+                                         std::conditional_t<sizeof(T) == 4, u32, u16>>;
+            return std::bit_cast<T>(bswap<U>(std::bit_cast<U>(x)));
+        }
+#endif
+        return x;
+    }
+
+    std::span<const std::byte> m_data;
+    usize                      m_pos { 0 };
+    bool                       m_ok { true };
+};
+
+// reader over a whole stream
+// uses the stream memory if it has, otherwise reads the content into a buffer
+class StreamReader : public BinaryReader, NoCopy, NoMove {
+public:
+    explicit StreamReader(std::shared_ptr<IBinaryStream> stream): m_stream(std::move(stream)) {
+        if (! m_stream) return;
+        auto data = m_stream->Data();
+        if (data.empty() && m_stream->Size() > 0) {
+            m_buf.resize(m_stream->Usize());
+            m_stream->Rewind();
+            m_buf.resize(m_stream->Read(m_buf.data(), m_buf.size()));
+            data = m_buf;
+        }
+        reset(data);
+    }
+
+private:
+    std::shared_ptr<IBinaryStream> m_stream;
+    std::vector<std::byte>         m_buf;
+};
+
+} // namespace fs
+} // namespace wallpaper
@@ -22,6 +22,7 @@ public:
 protected:
     CBinaryStream(std::string_view path, std::FILE* file): m_path(path), m_file(file) {}
     virtual usize Write_impl(const void* buffer, usize sizeInBytes) override {
+        m_size = -1;
         return std::fwrite(buffer, sizeInBytes, 1, m_file);
     }
 
@@ -38,16 +39,19 @@ public:
     virtual bool  SeekCur(idx offset) override { return std::fseek(m_file, offset, SEEK_CUR) == 0; }
     virtual bool  SeekEnd(idx offset) override { return std::fseek(m_file, offset, SEEK_END) == 0; }
     virtual isize Size() const override {
-        idx cur = std::ftell(m_file);
-        std::fseek(m_file, 0, SEEK_END);
-        idx size = std::ftell(m_file);
-        std::fseek(m_file, cur, SEEK_SET); // seek back
-        return size;
+        if (m_size < 0) {
+            idx cur = std::ftell(m_file);
+            std::fseek(m_file, 0, SEEK_END);
+            m_size = std::ftell(m_file);
+            std::fseek(m_file, cur, SEEK_SET); // seek back
+        }
+        return m_size;
     }
 
 private:
-    std::string m_path;
-    std::FILE*  m_file;
+    std::string   m_path;
+    std::FILE*    m_file;
+    mutable isize m_size { -1 }; // cached, reset by write
 };
 
 template<typename TBinaryStream>
@@ -75,6 +79,9 @@ inline std::shared_ptr<IBinaryStream> CreateCBinaryStream(std::string_view path)
 inline std::shared_ptr<IBinaryStreamW> CreateCBinaryStreamW(std::string_view path) {
     return t_CreateCBinaryStream<IBinaryStreamW>(path, "wb+");
 }
+inline std::shared_ptr<IBinaryStreamW> CreateCBinaryStreamA(std::string_view path) {
+    return t_CreateCBinaryStream<IBinaryStreamW>(path, "ab");
+}
 
 } // namespace fs
 } // namespace wallpaper
@@ -1,5 +1,8 @@
 #pragma once
 #include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
 
 #include "IBinaryStream.h"
 #include "Core/NoCopyMove.hpp"
@@ -14,6 +17,14 @@ public:
 	virtual bool Contains(std::string_view path) const = 0;
 	virtual std::shared_ptr<IBinaryStream> Open(std::string_view path) = 0;
 	virtual std::shared_ptr<IBinaryStreamW> OpenW(std::string_view path) = 0;
+	// memory backed stream (Data() not empty) if the fs can map the file
+	virtual std::shared_ptr<IBinaryStream> OpenMapped(std::string_view path) { return Open(path); }
+	// writes go to the end of the file, created if missing, nullptr if not supported
+	virtual std::shared_ptr<IBinaryStreamW> OpenAppend(std::string_view) { return nullptr; }
+	// replaces "to" if it exists, false if not supported
+	virtual bool Rename(std::string_view, std::string_view) { return false; }
+	// append all file paths ("/dir/file"), false if listing is not supported
+	virtual bool ListFiles(std::vector<std::string>&) const { return false; }
 public:
 	Fs() = default;
 	virtual ~Fs() = default;
@@ -1,5 +1,7 @@
 #pragma once
+#include <cstddef>
 #include <cstdint>
+#include <span>
 #include <string>
 #include <type_traits>
 #include "Bswap.hpp"
@@ -106,6 +108,10 @@ public:
 
     virtual isize Size() const = 0;
 
+    // whole content when the stream is backed by memory, empty otherwise
+    // valid as long as the stream is alive
+    virtual std::span<const std::byte> Data() const { return {}; }
+
 protected:
     virtual usize Write_impl(const void* buffer, usize sizeInByte) = 0;
 
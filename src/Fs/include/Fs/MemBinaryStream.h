@@ -59,6 +59,10 @@ public:
     }
     virtual isize Size() const { return std::ssize(m_data); }
 
+    virtual std::span<const std::byte> Data() const {
+        return { (const std::byte*)m_data.data(), m_data.size() };
+    }
+
 protected:
     virtual usize Write_impl(const void* buffer, usize sizeInByte) { return 0; }
 
@@ -76,5 +80,38 @@ private:
     std::vector<uint8_t> m_data;
 };
 
+// writes are appended to a byte vector, eg. to build a record before storing it
+class MemBinaryStreamW : public IBinaryStreamW {
+public:
+    MemBinaryStreamW()          = default;
+    virtual ~MemBinaryStreamW() = default;
+
+    const std::vector<uint8_t>& Buffer() const { return m_data; }
+    std::vector<uint8_t>        Take() { return std::move(m_data); }
+
+public:
+    virtual usize Read(void*, usize) override { return 0; }
+    virtual char* Gets(char* buffer, usize) override { return buffer; }
+    virtual idx   Tell() const override { return std::ssize(m_data); }
+    virtual bool  SeekSet(idx) override { return false; }
+    virtual bool  SeekCur(idx) override { return false; }
+    virtual bool  SeekEnd(idx) override { return false; }
+    virtual isize Size() const override { return std::ssize(m_data); }
+
+    virtual std::span<const std::byte> Data() const override {
+        return { (const std::byte*)m_data.data(), m_data.size() };
+    }
+
+protected:
+    virtual usize Write_impl(const void* buffer, usize sizeInByte) override {
+        auto* p = (const uint8_t*)buffer;
+        m_data.insert(m_data.end(), p, p + sizeInByte);
+        return 1;
+    }
+
+private:
+    std::vector<uint8_t> m_data;
+};
+
 } // namespace fs
 } // namespace wallpaper
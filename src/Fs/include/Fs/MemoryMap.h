@@ -0,0 +1,81 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <cerrno>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Core/NoCopyMove.hpp"
+#include "Core/Literals.hpp"
+#include "Utils/Logging.h"
+
+namespace wallpaper
+{
+namespace fs
+{
+
+// read-only mapping of a whole file, shared by the streams reading from it
+class MemoryMap : NoCopy, NoMove {
+public:
+    static std::shared_ptr<MemoryMap> Create(std::string_view path) {
+        std::string spath { path };
+        int         fd = ::open(spath.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            LOG_ERROR("can't open: %s, %s", spath.c_str(), std::strerror(errno));
+            return nullptr;
+        }
+        struct stat st;
+        if (::fstat(fd, &st) != 0 || ! S_ISREG(st.st_mode)) {
+            LOG_ERROR("can't map: %s, not a regular file", spath.c_str());
+            ::close(fd);
+            return nullptr;
+        }
+        usize size = (usize)st.st_size;
+        void* addr = nullptr;
+        if (size > 0) {
+            addr = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (addr == MAP_FAILED) {
+                LOG_ERROR("mmap %s failed, %s", spath.c_str(), std::strerror(errno));
+                ::close(fd);
+                return nullptr;
+            }
+        }
+        // mapping stays valid after close
+        ::close(fd);
+        return std::shared_ptr<MemoryMap>(new MemoryMap(addr, size));
+    }
+
+    ~MemoryMap() {
+        if (m_addr != nullptr) ::munmap(m_addr, m_size);
+    }
+
+    std::span<const std::byte> Data() const { return { (const std::byte*)m_addr, m_size }; }
+    usize                      Size() const { return m_size; }
+
+    // hint the kernel to read ahead a range, eg. a whole entry before parsing it
+    void WillNeed(usize offset, usize size) const {
+        if (m_addr == nullptr || offset >= m_size) return;
+        usize page  = (usize)::sysconf(_SC_PAGESIZE);
+        usize begin = offset / page * page;
+        usize end   = std::min(offset + size, m_size);
+        ::madvise((std::byte*)m_addr + begin, end - begin, MADV_WILLNEED);
+    }
+
+private:
+    MemoryMap(void* addr, usize size): m_addr(addr), m_size(size) {}
+
+    void* m_addr;
+    usize m_size;
+};
+
+} // namespace fs
+} // namespace wallpaper
@@ -3,6 +3,8 @@
 #include <filesystem>
 #include "Fs.h"
 #include "CBinaryStream.h"
+#include "MemoryMap.h"
+#include "SpanBinaryStream.h"
 #include "Utils/Logging.h"
 
 namespace wallpaper
@@ -18,14 +20,45 @@ public:
         auto fullpath = m_path / path.substr(1);
         return std::filesystem::exists(fullpath);
     }
+    bool ListFiles(std::vector<std::string>& paths) const override {
+        namespace stdfs = std::filesystem;
+        std::error_code                     ec;
+        stdfs::recursive_directory_iterator it(m_path,
+                                               stdfs::directory_options::follow_directory_symlink |
+                                                   stdfs::directory_options::skip_permission_denied,
+                                               ec),
+            end;
+        for (; ! ec && it != end; it.increment(ec)) {
+            std::error_code fec;
+            if (! it->is_regular_file(fec)) continue;
+            paths.push_back("/" + it->path().lexically_relative(m_path).generic_string());
+        }
+        return ! ec;
+    }
     std::shared_ptr<IBinaryStream> Open(std::string_view path) override {
         return CreateCBinaryStream(FullPath(path));
     }
+    std::shared_ptr<IBinaryStream> OpenMapped(std::string_view path) override {
+        auto map = MemoryMap::Create(FullPath(path));
+        if (! map) return nullptr;
+        return std::make_shared<SpanBinaryStream>(map->Data(), map);
+    }
     std::shared_ptr<IBinaryStreamW> OpenW(std::string_view path) override {
         std::filesystem::path full_path { FullPath(path) };
         std::filesystem::create_directories(full_path.parent_path());
         return CreateCBinaryStreamW(full_path.native());
     }
+    std::shared_ptr<IBinaryStreamW> OpenAppend(std::string_view path) override {
+        std::filesystem::path full_path { FullPath(path) };
+        std::filesystem::create_directories(full_path.parent_path());
+        return CreateCBinaryStreamA(full_path.native());
+    }
+    bool Rename(std::string_view from, std::string_view to) override {
+        std::error_code ec;
+        std::filesystem::rename(FullPath(from), FullPath(to), ec);
+        if (ec) LOG_ERROR("rename \"%s\" failed, %s", from.data(), ec.message().c_str());
+        return ! ec;
+    }
 
 private:
     std::string FullPath(std::string_view path) const {
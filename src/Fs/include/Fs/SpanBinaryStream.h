@@ -0,0 +1,59 @@
+#pragma once
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <span>
+
+#include "IBinaryStream.h"
+#include "Core/Literals.hpp"
+
+namespace wallpaper
+{
+namespace fs
+{
+
+// reads from memory owned by someone else, eg. a MemoryMap
+// the owner is kept alive as long as the stream
+class SpanBinaryStream : public IBinaryStream {
+public:
+    SpanBinaryStream(std::span<const std::byte> data, std::shared_ptr<const void> owner)
+        : m_pos(0), m_data(data), m_owner(std::move(owner)) {}
+    virtual ~SpanBinaryStream() = default;
+
+public:
+    virtual usize Read(void* buffer, usize sizeInByte) override {
+        usize n = std::min(sizeInByte, m_data.size() - (usize)m_pos);
+        if (n > 0) std::memcpy(buffer, m_data.data() + m_pos, n);
+        m_pos += (idx)n;
+        return n;
+    }
+    virtual char* Gets(char* buffer, usize sizeStr) override {
+        Read(buffer, sizeStr);
+        return buffer;
+    }
+    virtual idx  Tell() const override { return m_pos; }
+    virtual bool SeekSet(idx offset) override { return SeekTo(offset); }
+    virtual bool SeekCur(idx offset) override { return SeekTo(m_pos + offset); }
+    virtual bool SeekEnd(idx offset) override { return SeekTo(Size() + offset); }
+
+    virtual isize Size() const override { return (isize)m_data.size(); }
+
+    virtual std::span<const std::byte> Data() const override { return m_data; }
+
+protected:
+    virtual usize Write_impl(const void*, usize) override { return 0; }
+
+private:
+    bool SeekTo(idx pos) {
+        if (pos < 0 || pos > Size()) return false;
+        m_pos = pos;
+        return true;
+    }
+
+    idx                         m_pos;
+    std::span<const std::byte>  m_data;
+    std::shared_ptr<const void> m_owner;
+};
+
+} // namespace fs
+} // namespace wallpaper
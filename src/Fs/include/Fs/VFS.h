@@ -4,9 +4,17 @@
 #include <string>
 #include <tuple>
 #include <algorithm>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <atomic>
+#include <random>
 #include "Fs.h"
+#include "SpanBinaryStream.h"
 #include "Utils/Logging.h"
 #include "Core/NoCopyMove.hpp"
+#include "Core/MapSet.hpp"
+#include "Core/Literals.hpp"
 
 namespace wallpaper
 {
@@ -24,30 +32,40 @@ public:
 		std::string name;
 		std::string mountPoint; // full path of mount point in "/", last char can't be "/"
 		std::unique_ptr<Fs> fs;
+		bool writable {false};
+		// files listed in the index, otherwise queried by Contains
+		bool indexed {false};
 		static bool CheckMountPoint(const std::string_view mountPoint) {
 			return mountPoint[mountPoint.size()-1] != '/';
 		}
 		static bool InMountPoint(const std::string_view mountPoint, const std::string_view path) {
-			return path.compare(0, mountPoint.size() + 1, std::string(mountPoint) + '/') == 0;
+			return path.size() > mountPoint.size() && path.starts_with(mountPoint) &&
+				path[mountPoint.size()] == '/';
 		}
-		static std::string GetPathInMount(const std::string_view mountPoint, const std::string_view path) {
-			return std::string(path.substr(mountPoint.size()));
+		static std::string_view GetPathInMount(const std::string_view mountPoint, const std::string_view path) {
+			return path.substr(mountPoint.size());
 		}
 	};
 public:
+	// content read ahead by other threads, must be memory backed (Data() not empty)
+	using PrefetchFuture = std::shared_future<std::shared_ptr<IBinaryStream>>;
+
 	VFS() = default;
-	~VFS() = default;
+	~VFS() { ClearPrefetched(); }
 
-	bool Mount(std::string_view mountpoint, std::unique_ptr<Fs> fs, std::string_view name="") {
+	// writable mounts (eg. cache) are not indexed, every lookup goes to the fs
+	bool Mount(std::string_view mountpoint, std::unique_ptr<Fs> fs, std::string_view name="", bool writable=false) {
 		if(!MountedFs::CheckMountPoint(mountpoint) || !fs) return false;
 
-		m_mountedFss.push_back({std::string(name), std::string(mountpoint), std::move(fs)});
+		m_mountedFss.push_back({std::string(name), std::string(mountpoint), std::move(fs), writable});
+		indexMount(m_mountedFss.size() - 1);
 		return true;
 	}
 	bool Unmount(std::string_view mountpoint) {
 		for(auto iter = m_mountedFss.rbegin();iter < m_mountedFss.rend();iter++) {
 			if(iter->mountPoint == mountpoint) {
 				m_mountedFss.erase((++iter).base());
+				InvalidateIndex();
 				return true;
 			}
 		}
@@ -61,50 +79,178 @@ public:
 		}
 		return false;
 	}
+	// rebuild the path index, needed if files of a non-writable mount changed
+	void InvalidateIndex() {
+		m_index.clear();
+		for(usize i = 0;i < m_mountedFss.size();i++) indexMount(i);
+	}
 	std::shared_ptr<IBinaryStream> Open(std::string_view path) {
-        auto find_it = std::find_if(m_mountedFss.rbegin(), m_mountedFss.rend(), [&path](const auto& mfs) {
-			return MountedFs::InMountPoint(mfs.mountPoint, path) && 
-                   mfs.fs->Contains(MountedFs::GetPathInMount(mfs.mountPoint, path));
-        });
-        if(find_it != std::rend(m_mountedFss)) 
-            return find_it->fs->Open(MountedFs::GetPathInMount(find_it->mountPoint, path));
+		if(m_open_hook) m_open_hook(path);
+		if(auto file = openPrefetched(path); file) return file;
+		return OpenFromMount(path);
+	}
+	// skip prefetched content, used by the prefetch jobs
+	std::shared_ptr<IBinaryStream> OpenFromMount(std::string_view path) {
+		if(auto* mfs = find(path); mfs != nullptr)
+			return mfs->fs->Open(MountedFs::GetPathInMount(mfs->mountPoint, path));
+		LOG_ERROR("not found \"%s\" in vfs", path.data());
+		return nullptr;
+	}
+	// mapped when the mount supports it, for large cached files read in place
+	std::shared_ptr<IBinaryStream> OpenMapped(std::string_view path) {
+		if(auto* mfs = find(path); mfs != nullptr)
+			return mfs->fs->OpenMapped(MountedFs::GetPathInMount(mfs->mountPoint, path));
 		LOG_ERROR("not found \"%s\" in vfs", path.data());
 		return nullptr;
 	}
 	std::shared_ptr<IBinaryStreamW> OpenW(std::string_view path) {
-        auto find_it = std::find_if(m_mountedFss.rbegin(), m_mountedFss.rend(), [&path](const auto& mfs) {
-			return MountedFs::InMountPoint(mfs.mountPoint, path) && 
-                   mfs.fs->Contains(MountedFs::GetPathInMount(mfs.mountPoint, path));
-        });
-        if (find_it == std::rend(m_mountedFss)) {
-            find_it = std::find_if(m_mountedFss.rbegin(), m_mountedFss.rend(), [&path](const auto& mfs) {
-			    return MountedFs::InMountPoint(mfs.mountPoint, path);
-            });
-        }
-        if(find_it != std::rend(m_mountedFss))
-            return find_it->fs->OpenW(MountedFs::GetPathInMount(find_it->mountPoint, path));
+		if(auto* mfs = findForWrite(path); mfs != nullptr) {
+			auto file = mfs->fs->OpenW(MountedFs::GetPathInMount(mfs->mountPoint, path));
+			if(file && mfs->indexed) {
+				usize i = (usize)(mfs - m_mountedFss.data());
+				auto [it, ok] = m_index.try_emplace(std::string(path), i);
+				if(!ok) it->second = std::max(it->second, i);
+			}
+			return file;
+		}
+		LOG_ERROR("not found \"%s\" in vfs", path.data());
+		return nullptr;
+	}
+	// not indexed, only for writable mounts
+	std::shared_ptr<IBinaryStreamW> OpenAppend(std::string_view path) {
+		if(auto* mfs = findForWrite(path); mfs != nullptr && mfs->writable)
+			return mfs->fs->OpenAppend(MountedFs::GetPathInMount(mfs->mountPoint, path));
 		LOG_ERROR("not found \"%s\" in vfs", path.data());
 		return nullptr;
 	}
+	// both paths in the same writable mount
+	bool Rename(std::string_view from, std::string_view to) {
+		auto* mfs = find(from);
+		if(mfs == nullptr || !mfs->writable || !MountedFs::InMountPoint(mfs->mountPoint, to)) {
+			LOG_ERROR("can't rename \"%s\" in vfs", from.data());
+			return false;
+		}
+		return mfs->fs->Rename(MountedFs::GetPathInMount(mfs->mountPoint, from),
+							   MountedFs::GetPathInMount(mfs->mountPoint, to));
+	}
 	bool Contains(std::string_view path) const {
-		for(auto iter = m_mountedFss.rbegin();iter < m_mountedFss.rend();iter++) {
-			auto& el = *iter;
-			if(MountedFs::InMountPoint(el.mountPoint, path)) {
-				auto mpath = MountedFs::GetPathInMount(el.mountPoint, path);
-				if(el.fs->Contains(mpath))
-					return true;
-			}
+		return find(path) != nullptr;
+	}
+
+	// called on the opening thread with the path of every Open, eg. to record access order
+	using OpenHook = std::function<void(std::string_view path)>;
+	void SetOpenHook(OpenHook hook) { m_open_hook = std::move(hook); }
+
+	// first added wins, Open waits the future if it's not ready
+	void AddPrefetched(std::string_view path, PrefetchFuture content) {
+		std::unique_lock lock(m_prefetch_mutex);
+		m_prefetched.try_emplace(std::string(path), std::move(content));
+	}
+	bool IsPrefetched(std::string_view path) {
+		std::unique_lock lock(m_prefetch_mutex);
+		return m_prefetched.contains(path);
+	}
+	// a job that may still call AddPrefetched, waited before clearing
+	void AddPrefetchJob(std::shared_future<void> job) {
+		std::unique_lock lock(m_prefetch_mutex);
+		m_prefetch_jobs.push_back(std::move(job));
+	}
+	// wait pending jobs and release prefetched content
+	void ClearPrefetched() {
+		std::vector<std::shared_future<void>> jobs;
+		{
+			std::unique_lock lock(m_prefetch_mutex);
+			jobs.swap(m_prefetch_jobs);
 		}
-		return false;
+		for(auto& j:jobs) j.wait();
+
+		StringHashMap<PrefetchFuture> prefetched;
+		{
+			std::unique_lock lock(m_prefetch_mutex);
+			prefetched.swap(m_prefetched);
+		}
+		for(auto& el:prefetched) el.second.wait();
 	}
 private:
+	std::shared_ptr<IBinaryStream> openPrefetched(std::string_view path) {
+		PrefetchFuture content;
+		{
+			std::unique_lock lock(m_prefetch_mutex);
+			if(m_prefetched.empty()) return nullptr;
+			auto it = m_prefetched.find(path);
+			if(it == m_prefetched.end()) return nullptr;
+			content = it->second;
+		}
+		auto src = content.get();
+		if(!src || src->Data().empty()) return nullptr;
+		// new stream for each open, sharing the content
+		return std::make_shared<SpanBinaryStream>(src->Data(), src);
+	}
+
+	void indexMount(usize i) {
+		auto& mfs = m_mountedFss[i];
+		std::vector<std::string> paths;
+		mfs.indexed = !mfs.writable && mfs.fs->ListFiles(paths);
+		if(!mfs.indexed) return;
+		m_index.reserve(m_index.size() + paths.size());
+		for(auto& p:paths) {
+			m_index.insert_or_assign(mfs.mountPoint + p, i);
+		}
+	}
+	// mount that has the path, or the last one the path is in, for new files
+	MountedFs* findForWrite(std::string_view path) {
+		auto* mfs = find(path);
+		if(mfs == nullptr) {
+			auto find_it = std::find_if(m_mountedFss.rbegin(), m_mountedFss.rend(), [&path](const auto& mfs) {
+				return MountedFs::InMountPoint(mfs.mountPoint, path);
+			});
+			if(find_it != std::rend(m_mountedFss)) mfs = &(*find_it);
+		}
+		return mfs;
+	}
+	// mount that has the path, later mounted first
+	MountedFs* find(std::string_view path) const {
+		usize begin = 0;
+		const MountedFs* found = nullptr;
+		if(auto it = m_index.find(path); it != m_index.end()) {
+			begin = it->second + 1;
+			found = &m_mountedFss[it->second];
+		}
+		for(usize i = m_mountedFss.size();i > begin;i--) {
+			const auto& mfs = m_mountedFss[i - 1];
+			if(mfs.indexed || !MountedFs::InMountPoint(mfs.mountPoint, path)) continue;
+			if(mfs.fs->Contains(MountedFs::GetPathInMount(mfs.mountPoint, path))) {
+				found = &mfs;
+				break;
+			}
+		}
+		return const_cast<MountedFs*>(found);
+	}
+
 	std::vector<MountedFs> m_mountedFss;
+	// full path -> index of mount in m_mountedFss
+	StringHashMap<usize> m_index;
+	OpenHook m_open_hook;
+
+	std::mutex m_prefetch_mutex;
+	StringHashMap<PrefetchFuture> m_prefetched;
+	std::vector<std::shared_future<void>> m_prefetch_jobs;
 };
 
+// path to write before renaming over path, unique in and across processes
+// so concurrent writers of the same file don't share a temp file
+inline std::string TempPath(std::string_view path) {
+	static const u32 process { std::random_device {}() };
+	static std::atomic<u32> count { 0 };
+	return std::string(path) + "." + std::to_string(process) + "." + std::to_string(count++) + ".tmp";
+}
+
 inline std::string GetFileContent(fs::VFS& vfs, std::string_view path) {
 	auto f = vfs.Open(path);
-	if(f) return f->ReadAllStr();	
-	return "";
+	if(!f) return "";
+	if(auto data = f->Data(); !data.empty())
+		return std::string((const char*)data.data(), data.size());
+	return f->ReadAllStr();
 } 
 
 }
@@ -21,6 +21,26 @@ union ImageExtra {
 
 typedef std::unique_ptr<uint8_t, std::function<void(uint8_t*)>> ImageDataPtr;
 
+// destination of decoded image data, eg. mapped staging memory of the renderer
+// lets decoders write where the upload reads from, without an extra copy
+class IImageDataAllocator {
+public:
+    virtual ~IImageDataAllocator() = default;
+    // nullptr if failed, caller falls back to heap
+    // data must be released before the allocator
+    virtual ImageDataPtr AllocateImageData(usize size) = 0;
+};
+
+// block compression of rgba8 textures while decoding, the result is kept in the disk cache
+struct ImageTranscode {
+    // pixels of the first mipmap, smaller textures stay rgba8, 0 disables
+    usize min_pixels { 0 };
+    // mean squared error per channel above which a texture stays rgba8
+    float max_error { 32.0f };
+
+    bool enabled() const { return min_pixels > 0; }
+};
+
 struct ImageData {
     i32          width;
     i32          height;
@@ -60,7 +80,7 @@ struct Image : NoCopy, NoMove {
 
         std::vector<ImageData> mipmaps;
 
-        operator bool() { return width * height * std::ssize(mipmaps) > 0; }
+        operator bool() const { return width * height * std::ssize(mipmaps) > 0; }
     };
     ImageHeader       header;
     std::vector<Slot> slots;
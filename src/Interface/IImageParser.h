@@ -1,8 +1,10 @@
 #pragma once
 #include "Image.hpp"
 //#include "Fs/VFS.h"
+#include <future>
 #include <memory>
 #include <string>
+#include "Utils/ThreadPool.hpp"
 
 namespace wallpaper
 {
@@ -12,5 +14,23 @@ public:
     virtual ~IImageParser()                                        = default;
     virtual std::shared_ptr<Image> Parse(const std::string&)       = 0;
     virtual ImageHeader            ParseHeader(const std::string&) = 0;
+
+    // Parse on the worker pool, to overlap decoding with other loading
+    // the parser must outlive the future
+    virtual std::shared_future<std::shared_ptr<Image>> ParseAsync(const std::string& name) {
+        return utils::ThreadPool::Global()
+            .Post([this, name]() {
+                return Parse(name);
+            })
+            .share();
+    }
+    // decoded data is allocated from it when possible, nullptr for heap
+    void SetDataAllocator(IImageDataAllocator* allocator) { m_data_allocator = allocator; }
+    // only set when the device can sample bc formats
+    void SetTranscode(const ImageTranscode& transcode) { m_transcode = transcode; }
+
+protected:
+    IImageDataAllocator* m_data_allocator { nullptr };
+    ImageTranscode       m_transcode;
 };
 } // namespace wallpaper
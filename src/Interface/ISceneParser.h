@@ -13,6 +13,7 @@ class ISceneParser {
 public:
 	ISceneParser() = default;
 	virtual ~ISceneParser() = default;
-	virtual std::shared_ptr<Scene> Parse(std::string_view scene_id, const std::string&, fs::VFS&, audio::SoundManager&) = 0;
+	// pkg_id identifies the pkg content, for caches that outlive the scene
+	virtual std::shared_ptr<Scene> Parse(std::string_view scene_id, std::string_view pkg_id, const std::string&, fs::VFS&, audio::SoundManager&) = 0;
 };
 }
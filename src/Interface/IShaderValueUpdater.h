@@ -13,9 +13,45 @@ class SceneShader;
 class ShaderValue;
 class SpriteAnimation;
 
+// g_Texture0 to g_Texture12
+constexpr u16 UNIFORM_TEX_NUM { 13 };
+
+// uniforms set by the updater, passes bind them to block offsets once by id
+// names are from UniformName in SpecTexs.hpp
+enum class UniformId : u16
+{
+    M,
+    AM,
+    MI,
+    VP,
+    MVP,
+    MVPI,
+    ETVP,
+    ETVPI,
+    LP,
+    LCP,
+    TIME,
+    DAYTIME,
+    POINTERPOSITION,
+    PARALLAXPOSITION,
+    TEXELSIZE,
+    TEXELSIZEHALF,
+    SCREEN,
+    BONES,
+    // a run of UNIFORM_TEX_NUM each, see TexUniform
+    TEX_RESOLUTION,
+    TEX_MIPMAPINFO  = TEX_RESOLUTION + UNIFORM_TEX_NUM,
+    TEX_ROTATION    = TEX_MIPMAPINFO + UNIFORM_TEX_NUM,
+    TEX_TRANSLATION = TEX_ROTATION + UNIFORM_TEX_NUM,
+    COUNT           = TEX_TRANSLATION + UNIFORM_TEX_NUM,
+};
+constexpr UniformId TexUniform(UniformId base, usize index) {
+    return UniformId((usize)base + index);
+}
+
 using sprite_map_t    = Map<usize, SpriteAnimation>;
-using UpdateUniformOp = std::function<void(std::string_view, ShaderValue)>;
-using ExistsUniformOp = std::function<bool(std::string_view)>;
+using UpdateUniformOp = std::function<void(UniformId, const ShaderValue&)>;
+using ExistsUniformOp = std::function<bool(UniformId)>;
 
 class IShaderValueUpdater : NoCopy, NoMove {
 public:
@@ -3,6 +3,7 @@
 
 #include "Core/Visitors.hpp"
 #include "Utils/Logging.h"
+#include "Utils/Trace.h"
 
 #include <cassert>
 
@@ -29,7 +30,10 @@ bool Looper::loop() {
         msg = *m_msg_queue.begin();
         m_msg_queue.erase(m_msg_queue.begin());
     }
-    msg.msg->deliver();
+    {
+        WP_TRACE_SCOPE("looper deliver");
+        msg.msg->deliver();
+    }
     if (msg.msg->cleanAfterDeliver()) {
         msg.msg->cleanContent();
     }
@@ -47,6 +51,7 @@ status_t Looper::start() {
             {
                 looper = wlooper.lock().get();
                 LOG_INFO("%s looper started", looper->name().data());
+                trace::SetThreadName(looper->name());
                 looper->m_running = true;
             }
             std::string name { looper->name() };
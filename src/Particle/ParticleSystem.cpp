@@ -6,6 +6,7 @@
 #include "Core/Random.hpp"
 
 #include "Utils/Logging.h"
+#include "Utils/Trace.h"
 
 #include <algorithm>
 
@@ -199,6 +200,7 @@ void ParticleSubSystem::Emitt() {
 }
 
 void ParticleSystem::Emitt() {
+    WP_TRACE_SCOPE("particle emitt");
     for (auto& el : subsystems) {
         el->Emitt();
     }
@@ -162,3 +162,22 @@ std::vector<std::vector<TexNode*>> RenderGraph::getLastReadTexs(std::span<const
     });
     return res; 
 }
+
+std::vector<std::vector<NodeID>> RenderGraph::getInputWriters(std::span<const NodeID> nodes) const {
+    std::vector<std::vector<NodeID>> res;
+    for(auto n:nodes) {
+        Set<std::string_view> outs;
+        for(auto id:m_dg.GetNodeOut(n)) {
+            auto* tex = getTexNode(id);
+            if(tex != nullptr) outs.insert(tex->key());
+        }
+        std::vector<NodeID> writers;
+        for(auto id:m_dg.GetNodeIn(n)) {
+            auto* tex = getTexNode(id);
+            if(tex == nullptr || tex->writer() == nullptr || exists(outs, tex->key())) continue;
+            writers.push_back(tex->writer()->ID());
+        }
+        res.push_back(std::move(writers));
+    }
+    return res;
+}
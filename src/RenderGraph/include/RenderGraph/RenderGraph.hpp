@@ -43,6 +43,9 @@ public:
     // all render pass
     std::vector<NodeID>                topologicalOrder() const;
     std::vector<std::vector<TexNode*>> getLastReadTexs(std::span<const NodeID>) const;
+    // passes that wrote the textures each pass reads, not counting an older version of its
+    // own output, which it draws over
+    std::vector<std::vector<NodeID>> getInputWriters(std::span<const NodeID>) const;
 
     void ToGraphviz(std::string_view path) const { m_dg.ToGraphviz(path); };
 
@@ -86,6 +86,8 @@ public:
     */
 
     std::vector<ShaderCode> codes;
+    // serialized reflection of codes from the shader build, empty if not known
+    std::vector<uint8_t> reflection;
 
     std::vector<ShaderAttribute> attrs;
     ShaderValues                 default_uniforms;
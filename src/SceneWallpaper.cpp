@@ -6,14 +6,18 @@
 
 #include "Timer/FrameTimer.hpp"
 #include "Utils/FpsCounter.h"
+#include "Utils/Trace.h"
+#include "Utils/ContentStore.hpp"
 #include "WPSceneParser.hpp"
 #include "Scene/Scene.h"
+#include "Image.hpp"
 #include "Particle/ParticleSystem.h"
 #include "Interface/IShaderValueUpdater.h"
 
 #include "Fs/VFS.h"
 #include "Fs/PhysicalFs.h"
 #include "WPPkgFs.hpp"
+#include "WPAssetPrefetch.hpp"
 
 #include "Audio/SoundManager.h"
 
@@ -22,6 +26,7 @@
 #include "VulkanRender/SceneToRenderGraph.hpp"
 #include "VulkanRender/VulkanRender.hpp"
 #include <atomic>
+#include <filesystem>
 
 using namespace wallpaper;
 
@@ -47,6 +52,16 @@ std::shared_ptr<looper::Message> CreateMsgWithCmd(const std::shared_ptr<looper::
     AddMsgCmd(*msg, cmd);
     return msg;
 }
+
+// size and mtime, changes when the file is replaced or updated
+std::string FileIdentity(const std::filesystem::path& path) {
+    std::error_code ec;
+    auto            size = std::filesystem::file_size(path, ec);
+    if (ec) return {};
+    auto mtime = std::filesystem::last_write_time(path, ec);
+    if (ec) return {};
+    return std::to_string(size) + "-" + std::to_string(mtime.time_since_epoch().count());
+}
 } // namespace
 
 namespace wallpaper
@@ -127,6 +142,8 @@ public:
         CMD_SET_SCENE,
         CMD_SET_FILLMODE,
         CMD_SET_SPEED,
+        CMD_SET_VRAM_BUDGET,
+        CMD_SET_TEX_TRANSCODE,
         CMD_STOP,
         CMD_DRAW,
         CMD_NO
@@ -150,6 +167,8 @@ public:
                 CASE_CMD(SET_FILLMODE);
                 CASE_CMD(SET_SCENE);
                 CASE_CMD(SET_SPEED);
+                CASE_CMD(SET_VRAM_BUDGET);
+                CASE_CMD(SET_TEX_TRANSCODE);
                 CASE_CMD(INIT_VULKAN);
             default: break;
             }
@@ -173,6 +192,7 @@ private:
         }
     }
     MHANDLER_CMD(DRAW) {
+        WP_TRACE_SCOPE("frame");
         frame_timer.FrameBegin();
         if (m_rg) {
             // LOG_INFO("frame info, fps: %.1f, frametime: %.1f", 1.0f, 1000.0f*m_scene->frameTime);
@@ -208,15 +228,35 @@ private:
     }
     MHANDLER_CMD(SET_SCENE) {
         if (msg->findObject("scene", &m_scene)) {
+            WP_TRACE_SCOPE("set scene");
             if (m_rg) m_render->clearLastRenderGraph();
-            m_rg = sceneToRenderGraph(*m_scene);
+            {
+                WP_TRACE_SCOPE("scene to rendergraph");
+                m_rg = sceneToRenderGraph(*m_scene);
+            }
 
             if (main_handler.isGenGraphviz()) m_rg->ToGraphviz("graph.dot");
             m_render->compileRenderGraph(*m_scene, *m_rg);
             m_render->UpdateCameraFillMode(*m_scene, m_fillmode);
+            // textures are loaded, drop the read ahead content
+            if (m_scene->vfs) m_scene->vfs->ClearPrefetched();
         }
     }
     MHANDLER_CMD(SET_SPEED) { msg->findFloat("value", &m_speed); }
+    MHANDLER_CMD(SET_VRAM_BUDGET) {
+        int32_t mb { 0 };
+        if (msg->findInt32("value", &mb) && mb >= 0) {
+            m_render->setVramBudget((usize)mb * 1024u * 1024u);
+        }
+    }
+    MHANDLER_CMD(SET_TEX_TRANSCODE) {
+        int32_t size { 0 };
+        if (msg->findInt32("min_size", &size) && size >= 0) {
+            m_tex_transcode.min_pixels = (usize)size * (usize)size;
+        }
+        msg->findFloat("max_error", &m_tex_transcode.max_error);
+        m_render->setTexTranscode(m_tex_transcode);
+    }
     MHANDLER_CMD(INIT_VULKAN) {
         std::shared_ptr<RenderInitInfo> info;
         if (msg->findObject("info", &info)) {
@@ -238,7 +278,8 @@ private:
     std::unique_ptr<vulkan::VulkanRender> m_render;
     std::unique_ptr<rg::RenderGraph>      m_rg { nullptr };
 
-    FillMode m_fillmode { FillMode::ASPECTCROP };
+    FillMode       m_fillmode { FillMode::ASPECTCROP };
+    ImageTranscode m_tex_transcode;
 
     std::atomic<std::array<float, 2>> m_mouse_pos { std::array { 0.5f, 0.5f } };
 };
@@ -247,6 +288,7 @@ private:
 SceneWallpaper::SceneWallpaper(): m_main_handler(std::make_shared<MainHandler>()) {}
 
 SceneWallpaper::~SceneWallpaper() {
+    if (trace::IsRunning()) trace::Stop();
     /*
     if(m_offscreen) {
         // no wait
@@ -353,6 +395,40 @@ MHANDLER_CMD_IMPL(MainHandler, SET_PROPERTY) {
             std::shared_ptr<FirstFrameCallback> cb;
             msg->findObject("value", &cb);
             m_first_frame_callback = *cb;
+        } else if (property == PROPERTY_TRACE_FILE) {
+            std::string path;
+            msg->findString("value", &path);
+            if (trace::IsRunning()) trace::Stop();
+            if (! path.empty()) trace::Start(path);
+        } else if (property == PROPERTY_CONTENT_CACHE_MB) {
+            int32_t mb { 0 };
+            if (msg->findInt32("value", &mb) && mb >= 0) {
+                utils::ContentStore::Global().SetBudget((usize)mb * 1024u * 1024u);
+            }
+        } else if (property == PROPERTY_VRAM_BUDGET_MB) {
+            int32_t mb { 0 };
+            if (msg->findInt32("value", &mb)) {
+                auto nmsg =
+                    CreateMsgWithCmd(m_render_handler, RenderHandler::CMD::CMD_SET_VRAM_BUDGET);
+                nmsg->setInt32("value", mb);
+                nmsg->post();
+            }
+        } else if (property == PROPERTY_TEX_BC_MIN_SIZE) {
+            int32_t size { 0 };
+            if (msg->findInt32("value", &size)) {
+                auto nmsg =
+                    CreateMsgWithCmd(m_render_handler, RenderHandler::CMD::CMD_SET_TEX_TRANSCODE);
+                nmsg->setInt32("min_size", size);
+                nmsg->post();
+            }
+        } else if (property == PROPERTY_TEX_BC_MAX_ERROR) {
+            float error { 0.0f };
+            if (msg->findFloat("value", &error)) {
+                auto nmsg =
+                    CreateMsgWithCmd(m_render_handler, RenderHandler::CMD::CMD_SET_TEX_TRANSCODE);
+                nmsg->setFloat("max_error", error);
+                nmsg->post();
+            }
         } else if (property == PROPERTY_SPEED) {
             float speed { 1.0f };
             if (msg->findFloat("value", &speed)) {
@@ -387,6 +463,7 @@ void MainHandler::loadScene() {
     if (m_source.empty() || m_assets.empty()) return;
 
     LOG_INFO("loading scene: %s", m_source.c_str());
+    WP_TRACE_SCOPE("load scene");
 
     if (! m_sound_manager->IsInited()) {
         m_sound_manager->Init();
@@ -414,9 +491,12 @@ void MainHandler::loadScene() {
     std::string pkgDir   = pkgPath_fs.parent_path().native();
     std::string scene_id = pkgPath_fs.parent_path().filename().native();
 
+    std::string pkg_id = FileIdentity(pkgPath_fs);
+
     // load pkgfile
     if (! vfs.Mount("/assets", fs::WPPkgFs::CreatePkgFs(pkgPath))) {
         LOG_INFO("load pkg file %s failed, fallback to use dir", pkgPath.c_str());
+        pkg_id = FileIdentity(pkgPath_fs.parent_path() / pkgEntry);
         // load pkg dir
         if (! vfs.Mount("/assets", fs::CreatePhysicalFs(pkgDir))) {
             LOG_ERROR("can't load pkg directory: %s", pkgDir.c_str());
@@ -424,10 +504,11 @@ void MainHandler::loadScene() {
         }
     }
     if (! m_cache_path.empty()) {
-        if (! vfs.Mount("/cache", fs::CreatePhysicalFs(m_cache_path, true), "cache")) {
+        if (! vfs.Mount("/cache", fs::CreatePhysicalFs(m_cache_path, true), "cache", true)) {
             LOG_ERROR("can't load cache folder: %s", m_cache_path.c_str());
         } else {
             LOG_INFO("cache folder: %s", m_cache_path.c_str());
+            m_scene_parser.SetCachePath(m_cache_path);
         }
     }
 
@@ -445,7 +526,10 @@ void MainHandler::loadScene() {
             LOG_ERROR("Not supported scene type");
             return;
         }
-        scene = m_scene_parser.Parse(scene_id, scene_src, vfs, *m_sound_manager);
+        WPAssetPrefetch::Prefetch(scene_src, vfs);
+
+        WP_TRACE_SCOPE("parse scene");
+        scene = m_scene_parser.Parse(scene_id, pkg_id, scene_src, vfs, *m_sound_manager);
         scene->vfs.swap(pVfs);
     }
 
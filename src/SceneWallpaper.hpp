@@ -20,6 +20,15 @@ constexpr std::string_view PROPERTY_VOLUME               = "volume";
 constexpr std::string_view PROPERTY_MUTED                = "muted";
 constexpr std::string_view PROPERTY_CACHE_PATH           = "cache_path";
 constexpr std::string_view PROPERTY_FIRST_FRAME_CALLBACK = "first_frame_callback";
+constexpr std::string_view PROPERTY_TRACE_FILE           = "trace_file";
+// memory budget of decoded assets shared by all wallpapers, 0 disables
+constexpr std::string_view PROPERTY_CONTENT_CACHE_MB     = "content_cache_mb";
+// textures are shrunk above this vram usage, 0 uses the driver budget only
+constexpr std::string_view PROPERTY_VRAM_BUDGET_MB       = "vram_budget_mb";
+// rgba8 textures of at least size x size pixels are block compressed when loaded, 0 disables
+constexpr std::string_view PROPERTY_TEX_BC_MIN_SIZE      = "tex_bc_min_size";
+// mean squared error per channel above which a texture is not block compressed
+constexpr std::string_view PROPERTY_TEX_BC_MAX_ERROR     = "tex_bc_max_error";
 
 #include "Core/NoCopyMove.hpp"
 class MainHandler;
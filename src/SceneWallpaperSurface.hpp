@@ -26,6 +26,8 @@ struct RenderInitInfo {
 
     uint16_t width { 1920 };
     uint16_t height { 1080 };
+    // frames recorded while the gpu still works on earlier ones, 1 waits every frame
+    uint32_t frames_in_flight { 2 };
     ReDrawCB redraw_callback;
 };
 
@@ -4,6 +4,7 @@
 #include "Core/Literals.hpp"
 #include "Core/StringHelper.hpp"
 #include "Utils/String.h"
+#include "Interface/IShaderValueUpdater.h"
 
 namespace wallpaper
 {
@@ -71,6 +72,41 @@ constexpr std::string_view G_BONES { "g_Bones" };
 constexpr std::string_view G_SCREEN { "g_Screen" };
 constexpr std::string_view G_PARALLAXPOSITION { "g_ParallaxPosition" };
 
+// in UniformId order
+constexpr std::array WE_UNIFORM_NAMES { G_M,
+                                        G_AM,
+                                        G_MI,
+                                        G_VP,
+                                        G_MVP,
+                                        G_MVPI,
+                                        G_ETVP,
+                                        G_ETVPI,
+                                        G_LP,
+                                        G_LCP,
+                                        G_TIME,
+                                        G_DAYTIME,
+                                        G_POINTERPOSITION,
+                                        G_PARALLAXPOSITION,
+                                        G_TEXELSIZE,
+                                        G_TEXELSIZEHALF,
+                                        G_SCREEN,
+                                        G_BONES };
+static_assert(WE_UNIFORM_NAMES.size() == (usize)UniformId::TEX_RESOLUTION);
+static_assert(WE_GLTEX_NAMES.size() == UNIFORM_TEX_NUM);
+
+constexpr std::string_view UniformName(UniformId id) {
+    usize i = (usize)id;
+    if (i < WE_UNIFORM_NAMES.size()) return WE_UNIFORM_NAMES[i];
+    i -= WE_UNIFORM_NAMES.size();
+    switch (i / UNIFORM_TEX_NUM) {
+    case 0: return WE_GLTEX_RESOLUTION_NAMES[i % UNIFORM_TEX_NUM];
+    case 1: return WE_GLTEX_MIPMAPINFO_NAMES[i % UNIFORM_TEX_NUM];
+    case 2: return WE_GLTEX_ROTATION_NAMES[i % UNIFORM_TEX_NUM];
+    case 3: return WE_GLTEX_TRANSLATION_NAMES[i % UNIFORM_TEX_NUM];
+    default: return {};
+    }
+}
+
 constexpr std::string_view SpecTex_Default { "_rt_default" };
 constexpr std::string_view SpecTex_Link { "_rt_link_" };
 
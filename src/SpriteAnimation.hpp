@@ -37,6 +37,7 @@ public:
     void        AppendFrame(const SpriteFrame& frame) { m_frames.push_back(frame); }
 
     usize numFrames() const { return m_frames.size(); }
+    const auto& frames() const { return m_frames; }
 
 private:
     void SwitchToNext() {
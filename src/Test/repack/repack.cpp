@@ -0,0 +1,231 @@
+#include "WPPkgFs.hpp"
+#include "WPSceneParser.hpp"
+#include "WPTexImageParser.hpp"
+#include "Fs/BinaryReader.h"
+#include "Fs/CBinaryStream.h"
+#include "Fs/MemoryMap.h"
+#include "Fs/PhysicalFs.h"
+#include "Fs/VFS.h"
+#include "Audio/SoundManager.h"
+#include "Core/MapSet.hpp"
+#include "Utils/Logging.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <limits>
+#include <variant>
+
+/*
+ * repack a scene pkg for sequential reads on first load
+ * entries are ordered by first open during a scene load, page aligned
+ * --predecode adds "<tex>.texc" entries holding decoded textures (see WPTexImageParser)
+ *
+ * usage: repack <assets dir> <scene.pkg> <out.pkg> [--predecode]
+ */
+
+using namespace wallpaper;
+
+namespace
+{
+constexpr usize PAGE_SIZE { 4096 };
+
+inline usize AlignPage(usize x) { return (x + PAGE_SIZE - 1) / PAGE_SIZE * PAGE_SIZE; }
+
+struct Entry {
+    std::string name; // without leading "/"
+    usize       size { 0 };
+    usize       offset { 0 };
+
+    std::variant<std::span<const std::byte>, std::shared_ptr<Image>> content;
+};
+
+std::string_view ReadSizedString(fs::BinaryReader& f) {
+    i32 len = f.ReadInt32();
+    if (len < 0) return {};
+    auto str = f.ReadBytes((usize)len);
+    return { (const char*)str.data(), str.size() };
+}
+void WriteSizedString(fs::IBinaryStreamW& f, std::string_view str) {
+    f.WriteInt32((i32)str.size());
+    f.Write(str.data(), str.size());
+}
+
+// entries in pkg order, spans into the map
+bool ReadPkg(const fs::MemoryMap& map, std::string& version, std::vector<Entry>& entries) {
+    fs::BinaryReader pkg(map.Data());
+    version   = ReadSizedString(pkg);
+    i32 count = pkg.ReadInt32();
+    struct Raw {
+        std::string_view name;
+        i32              offset, length;
+    };
+    std::vector<Raw> raws;
+    for (i32 i = 0; i < count && pkg.ok(); i++) {
+        auto name   = ReadSizedString(pkg);
+        i32  offset = pkg.ReadInt32();
+        i32  length = pkg.ReadInt32();
+        raws.push_back({ name, offset, length });
+    }
+    if (! pkg.ok()) return false;
+
+    usize header_size = pkg.Tell();
+    for (auto& r : raws) {
+        usize begin = header_size + (usize)r.offset;
+        if (r.offset < 0 || r.length < 0 || begin + (usize)r.length > map.Size()) {
+            LOG_ERROR("pkg entry \"%.*s\" out of range", (int)r.name.size(), r.name.data());
+            return false;
+        }
+        entries.push_back({ .name    = std::string(r.name),
+                            .size    = (usize)r.length,
+                            .content = map.Data().subspan(begin, (usize)r.length) });
+    }
+    return true;
+}
+
+// record the files opened by parsing the scene
+std::vector<std::string> RecordOpenOrder(fs::VFS& vfs, std::string_view scene_entry) {
+    std::vector<std::string> order;
+    StringHashSet            seen;
+    vfs.SetOpenHook([&order, &seen](std::string_view path) {
+        constexpr std::string_view prefix { "/assets/" };
+        if (! path.starts_with(prefix)) return;
+        auto name = path.substr(prefix.size());
+        if (seen.contains(name)) return;
+        seen.insert(std::string(name));
+        order.emplace_back(name);
+    });
+
+    std::string scene_src = fs::GetFileContent(vfs, "/assets/" + std::string(scene_entry));
+    if (scene_src.empty()) {
+        LOG_ERROR("can't read scene \"%.*s\"", (int)scene_entry.size(), scene_entry.data());
+    } else {
+        audio::SoundManager sm;
+        WPSceneParser       parser;
+        // tex headers are read while parsing, same order the renderer loads them
+        (void)parser.Parse("", "", scene_src, vfs, sm);
+    }
+    vfs.SetOpenHook(nullptr);
+    return order;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc < 4) {
+        LOG_ERROR("usage: %s <assets dir> <scene.pkg> <out.pkg> [--predecode]", argv[0]);
+        return 1;
+    }
+    std::filesystem::path pkg_path { argv[2] }, out_path { argv[3] };
+    bool predecode = argc > 4 && std::strcmp(argv[4], "--predecode") == 0;
+
+    std::error_code ec;
+    if (std::filesystem::equivalent(pkg_path, out_path, ec)) {
+        LOG_ERROR("output can't be the input pkg");
+        return 1;
+    }
+
+    auto map = fs::MemoryMap::Create(pkg_path.native());
+    if (! map) return 1;
+    std::string        version;
+    std::vector<Entry> entries;
+    if (! ReadPkg(*map, version, entries)) {
+        LOG_ERROR("read pkg \"%s\" failed", pkg_path.c_str());
+        return 1;
+    }
+    if (predecode) {
+        // regenerated below
+        std::erase_if(entries, [](const Entry& e) {
+            return e.name.ends_with(".texc");
+        });
+    }
+
+    fs::VFS vfs;
+    if (! vfs.Mount("/assets", fs::CreatePhysicalFs(argv[1]), "assets") ||
+        ! vfs.Mount("/assets", fs::WPPkgFs::CreatePkgFs(pkg_path.native()))) {
+        LOG_ERROR("mount failed");
+        return 1;
+    }
+
+    std::string scene_entry = pkg_path.filename().replace_extension("json").native();
+    auto        order       = RecordOpenOrder(vfs, scene_entry);
+
+    // opened first, in open order, the rest keep the pkg order
+    StringHashMap<usize> rank;
+    for (usize i = 0; i < order.size(); i++) rank.emplace(order[i], i);
+    auto rank_of = [&rank](const Entry& e) {
+        auto it = rank.find(e.name);
+        return it == rank.end() ? std::numeric_limits<usize>::max() : it->second;
+    };
+    std::stable_sort(entries.begin(), entries.end(), [&rank_of](const Entry& a, const Entry& b) {
+        return rank_of(a) < rank_of(b);
+    });
+    usize opened = (usize)std::count_if(entries.begin(), entries.end(), [&rank](const Entry& e) {
+        return rank.contains(e.name);
+    });
+
+    if (predecode) {
+        WPTexImageParser   tex_parser(&vfs);
+        std::vector<Entry> with_decoded;
+        for (auto& e : entries) {
+            std::string name   = e.name;
+            bool        is_tex = name.starts_with("materials/") && name.ends_with(".tex");
+            with_decoded.push_back(std::move(e));
+            if (! is_tex) continue;
+
+            auto img = tex_parser.Parse(name.substr(10, name.size() - 10 - 4));
+            if (! img || img->header.extraHeader["decoded"].val == 0) continue;
+            with_decoded.push_back({ .name    = name + "c",
+                                     .size    = WPTexImageParser::DecodedSize(*img),
+                                     .content = img });
+        }
+        entries = std::move(with_decoded);
+    }
+
+    // header: version, count, (name, offset, length)
+    usize header_size = 4 + version.size() + 4;
+    for (auto& e : entries) header_size += 4 + e.name.size() + 4 * 2;
+
+    usize end = header_size;
+    for (auto& e : entries) {
+        usize begin = AlignPage(end);
+        e.offset    = begin - header_size;
+        end         = begin + e.size;
+    }
+    if (end > (usize)std::numeric_limits<i32>::max()) {
+        LOG_ERROR("repacked pkg too large");
+        return 1;
+    }
+
+    auto out = fs::CreateCBinaryStreamW(out_path.native());
+    if (! out) return 1;
+    WriteSizedString(*out, version);
+    out->WriteInt32((i32)entries.size());
+    for (auto& e : entries) {
+        WriteSizedString(*out, e.name);
+        out->WriteInt32((i32)e.offset);
+        out->WriteInt32((i32)e.size);
+    }
+
+    std::vector<char> pad(PAGE_SIZE, '\0');
+    usize             pos = header_size;
+    for (auto& e : entries) {
+        usize begin = header_size + e.offset;
+        out->Write(pad.data(), begin - pos);
+        if (auto* span = std::get_if<std::span<const std::byte>>(&e.content)) {
+            out->Write(span->data(), span->size());
+        } else if (! WPTexImageParser::WriteDecoded(*std::get<std::shared_ptr<Image>>(e.content),
+                                                    *out)) {
+            LOG_ERROR("write \"%s\" failed", e.name.c_str());
+            return 1;
+        }
+        pos = begin + e.size;
+    }
+
+    LOG_INFO("repacked %zu entries (%zu opened on load) to %s, %zu bytes",
+             entries.size(),
+             opened,
+             out_path.c_str(),
+             end);
+    return 0;
+}
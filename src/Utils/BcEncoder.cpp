@@ -0,0 +1,329 @@
+#include "BcEncoder.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+#if defined(__SSE2__)
+#    include <emmintrin.h>
+#endif
+
+using namespace utils;
+
+namespace
+{
+// one 4x4 block, channels split for simd
+struct Block {
+    alignas(16) float r[16];
+    alignas(16) float g[16];
+    alignas(16) float b[16];
+    alignas(16) float a[16];
+};
+
+// expanded rgb of the four colors of a color block
+struct Palette {
+    float r[4];
+    float g[4];
+    float b[4];
+};
+
+void LoadBlock(const uint8_t* rgba, uint32_t width, uint32_t height, uint32_t bx, uint32_t by,
+               Block& block) {
+    for (uint32_t y = 0; y < 4; y++) {
+        uint32_t       sy  = std::min(by * 4 + y, height - 1);
+        const uint8_t* row = rgba + (std::size_t)sy * width * 4;
+        for (uint32_t x = 0; x < 4; x++) {
+            const uint8_t* p = row + (std::size_t)std::min(bx * 4 + x, width - 1) * 4;
+            uint32_t       i = y * 4 + x;
+            block.r[i]       = p[0];
+            block.g[i]       = p[1];
+            block.b[i]       = p[2];
+            block.a[i]       = p[3];
+        }
+    }
+}
+
+uint16_t To565(const float c[3]) {
+    auto q = [](float v, int max) {
+        return (uint16_t)std::clamp((int)std::lround(v * (float)max / 255.0f), 0, max);
+    };
+    return (uint16_t)(q(c[0], 31) << 11 | q(c[1], 63) << 5 | q(c[2], 31));
+}
+
+Palette MakePalette(uint16_t c0, uint16_t c1) {
+    auto expand = [](uint16_t c, int ch) {
+        int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+        switch (ch) {
+        case 0: return r << 3 | r >> 2;
+        case 1: return g << 2 | g >> 4;
+        default: return b << 3 | b >> 2;
+        }
+    };
+    Palette pal;
+    float*  out[3] { pal.r, pal.g, pal.b };
+    for (int ch = 0; ch < 3; ch++) {
+        int e0     = expand(c0, ch);
+        int e1     = expand(c1, ch);
+        out[ch][0] = (float)e0;
+        out[ch][1] = (float)e1;
+        out[ch][2] = (float)((2 * e0 + e1) / 3);
+        out[ch][3] = (float)((e0 + 2 * e1) / 3);
+    }
+    return pal;
+}
+
+// nearest palette color of every pixel, returns the squared error
+float FitIndices(const Block& block, const Palette& pal, uint32_t& indices) {
+    indices = 0;
+#if defined(__SSE2__)
+    __m128 total = _mm_setzero_ps();
+    for (uint32_t i = 0; i < 16; i += 4) {
+        __m128  r        = _mm_load_ps(block.r + i);
+        __m128  g        = _mm_load_ps(block.g + i);
+        __m128  b        = _mm_load_ps(block.b + i);
+        __m128  best     = _mm_set1_ps(std::numeric_limits<float>::max());
+        __m128i best_idx = _mm_setzero_si128();
+        for (int k = 0; k < 4; k++) {
+            __m128 dr = _mm_sub_ps(r, _mm_set1_ps(pal.r[k]));
+            __m128 dg = _mm_sub_ps(g, _mm_set1_ps(pal.g[k]));
+            __m128 db = _mm_sub_ps(b, _mm_set1_ps(pal.b[k]));
+            __m128 d  = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dr, dr), _mm_mul_ps(dg, dg)),
+                                  _mm_mul_ps(db, db));
+
+            __m128i less = _mm_castps_si128(_mm_cmplt_ps(d, best));
+            best         = _mm_min_ps(d, best);
+            best_idx     = _mm_or_si128(_mm_andnot_si128(less, best_idx),
+                                    _mm_and_si128(less, _mm_set1_epi32(k)));
+        }
+        total = _mm_add_ps(total, best);
+
+        alignas(16) int32_t idx[4];
+        _mm_store_si128((__m128i*)idx, best_idx);
+        for (uint32_t j = 0; j < 4; j++) indices |= (uint32_t)idx[j] << (2 * (i + j));
+    }
+    alignas(16) float sum[4];
+    _mm_store_ps(sum, total);
+    return sum[0] + sum[1] + sum[2] + sum[3];
+#else
+    float total { 0.0f };
+    for (uint32_t i = 0; i < 16; i++) {
+        float    best { std::numeric_limits<float>::max() };
+        uint32_t best_idx { 0 };
+        for (uint32_t k = 0; k < 4; k++) {
+            float dr = block.r[i] - pal.r[k];
+            float dg = block.g[i] - pal.g[k];
+            float db = block.b[i] - pal.b[k];
+            float d  = dr * dr + dg * dg + db * db;
+            if (d < best) {
+                best     = d;
+                best_idx = k;
+            }
+        }
+        total += best;
+        indices |= best_idx << (2 * i);
+    }
+    return total;
+#endif
+}
+
+// ends of the principal axis of the block colors
+void PrincipalEndpoints(const Block& block, float lo[3], float hi[3]) {
+    const float* ch[3] { block.r, block.g, block.b };
+
+    float mean[3] {}, min[3], max[3];
+    for (int c = 0; c < 3; c++) {
+        min[c] = max[c] = ch[c][0];
+        for (int i = 0; i < 16; i++) {
+            mean[c] += ch[c][i];
+            min[c] = std::min(min[c], ch[c][i]);
+            max[c] = std::max(max[c], ch[c][i]);
+        }
+        mean[c] /= 16.0f;
+    }
+
+    // rr, rg, rb, gg, gb, bb
+    float cov[6] {};
+    for (int i = 0; i < 16; i++) {
+        float r = ch[0][i] - mean[0], g = ch[1][i] - mean[1], b = ch[2][i] - mean[2];
+        cov[0] += r * r;
+        cov[1] += r * g;
+        cov[2] += r * b;
+        cov[3] += g * g;
+        cov[4] += g * b;
+        cov[5] += b * b;
+    }
+
+    // power iteration from the bounding box diagonal
+    float axis[3] { max[0] - min[0], max[1] - min[1], max[2] - min[2] };
+    for (int it = 0; it < 4; it++) {
+        float v[3] {
+            cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2],
+            cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2],
+            cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2],
+        };
+        float m = std::max({ std::abs(v[0]), std::abs(v[1]), std::abs(v[2]) });
+        if (m < 1e-6f) break;
+        for (int c = 0; c < 3; c++) axis[c] = v[c] / m;
+    }
+    float len = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+    if (len < 1e-6f) {
+        for (int c = 0; c < 3; c++) lo[c] = hi[c] = mean[c];
+        return;
+    }
+    for (auto& v : axis) v /= len;
+
+    float tmin { std::numeric_limits<float>::max() }, tmax { -std::numeric_limits<float>::max() };
+    for (int i = 0; i < 16; i++) {
+        float t = (ch[0][i] - mean[0]) * axis[0] + (ch[1][i] - mean[1]) * axis[1] +
+                  (ch[2][i] - mean[2]) * axis[2];
+        tmin = std::min(tmin, t);
+        tmax = std::max(tmax, t);
+    }
+    for (int c = 0; c < 3; c++) {
+        lo[c] = std::clamp(mean[c] + tmin * axis[c], 0.0f, 255.0f);
+        hi[c] = std::clamp(mean[c] + tmax * axis[c], 0.0f, 255.0f);
+    }
+}
+
+// least squares endpoints for fixed indices, false if all pixels use one end
+bool RefineEndpoints(const Block& block, uint32_t indices, float c0[3], float c1[3]) {
+    constexpr float w0[4] { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+    const float*    ch[3] { block.r, block.g, block.b };
+
+    float aa { 0 }, bb { 0 }, ab { 0 };
+    float ax[3] {}, bx[3] {};
+    for (uint32_t i = 0; i < 16; i++) {
+        float a = w0[(indices >> (2 * i)) & 3u];
+        float b = 1.0f - a;
+        aa += a * a;
+        bb += b * b;
+        ab += a * b;
+        for (int c = 0; c < 3; c++) {
+            ax[c] += a * ch[c][i];
+            bx[c] += b * ch[c][i];
+        }
+    }
+    float det = aa * bb - ab * ab;
+    if (std::abs(det) < 1e-6f) return false;
+    for (int c = 0; c < 3; c++) {
+        c0[c] = std::clamp((ax[c] * bb - bx[c] * ab) / det, 0.0f, 255.0f);
+        c1[c] = std::clamp((bx[c] * aa - ax[c] * ab) / det, 0.0f, 255.0f);
+    }
+    return true;
+}
+
+// 8 bytes, always four color mode
+float EncodeColor(const Block& block, uint8_t* out) {
+    float lo[3], hi[3];
+    PrincipalEndpoints(block, lo, hi);
+
+    uint16_t c0 = To565(hi), c1 = To565(lo);
+    uint32_t indices;
+    float    err = FitIndices(block, MakePalette(c0, c1), indices);
+
+    if (float r0[3], r1[3]; err > 0.0f && RefineEndpoints(block, indices, r0, r1)) {
+        uint16_t n0 = To565(r0), n1 = To565(r1);
+        uint32_t n_indices;
+        float    n_err = FitIndices(block, MakePalette(n0, n1), n_indices);
+        if (n_err < err) {
+            c0      = n0;
+            c1      = n1;
+            indices = n_indices;
+            err     = n_err;
+        }
+    }
+
+    // c0 > c1 selects four colors in bc1, swapping the ends swaps index 0/1 and 2/3
+    if (c0 < c1) {
+        std::swap(c0, c1);
+        indices ^= 0x55555555u;
+    } else if (c0 == c1) {
+        // three color mode, index 3 would be transparent
+        indices = 0;
+    }
+    out[0] = (uint8_t)(c0 & 0xFF);
+    out[1] = (uint8_t)(c0 >> 8);
+    out[2] = (uint8_t)(c1 & 0xFF);
+    out[3] = (uint8_t)(c1 >> 8);
+    for (uint32_t i = 0; i < 4; i++) out[4 + i] = (uint8_t)(indices >> (8 * i));
+    return err;
+}
+
+// 8 bytes, always eight alpha mode
+float EncodeAlpha(const Block& block, uint8_t* out) {
+    float amin = *std::min_element(block.a, block.a + 16);
+    float amax = *std::max_element(block.a, block.a + 16);
+
+    int   a0 = (int)amax, a1 = (int)amin;
+    float pal[8] { (float)a0, (float)a1 };
+    for (int i = 2; i < 8; i++) pal[i] = (float)(((8 - i) * a0 + (i - 1) * a1) / 7);
+
+    uint64_t bits { 0 };
+    float    err { 0.0f };
+    for (uint32_t i = 0; i < 16; i++) {
+        uint64_t idx { 0 };
+        if (a0 > a1) {
+            // steps from a1 to a0, 0 and 7 are the ends
+            int k = std::clamp((int)std::lround((block.a[i] - amin) * 7.0f / (amax - amin)), 0, 7);
+            idx   = k == 7 ? 0u : (k == 0 ? 1u : (uint64_t)(8 - k));
+        }
+        float d = block.a[i] - pal[idx];
+        err += d * d;
+        bits |= idx << (3 * i);
+    }
+    out[0] = (uint8_t)a0;
+    out[1] = (uint8_t)a1;
+    for (uint32_t i = 0; i < 6; i++) out[2 + i] = (uint8_t)(bits >> (8 * i));
+    return err;
+}
+} // namespace
+
+std::size_t bc::CompressedSize(std::uint32_t width, std::uint32_t height, std::size_t block_size) {
+    return (std::size_t)((width + 3) / 4) * ((height + 3) / 4) * block_size;
+}
+
+bool bc::IsOpaque(const std::uint8_t* rgba, std::size_t pixel_count) {
+    std::size_t i { 0 };
+#if defined(__SSE2__)
+    const __m128i mask = _mm_set1_epi32((int)0xFF000000u);
+    for (; i + 4 <= pixel_count; i += 4) {
+        __m128i px = _mm_loadu_si128((const __m128i*)(rgba + i * 4));
+        __m128i a  = _mm_and_si128(px, mask);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(a, mask)) != 0xFFFF) return false;
+    }
+#endif
+    for (; i < pixel_count; i++) {
+        if (rgba[i * 4 + 3] != 255) return false;
+    }
+    return true;
+}
+
+std::uint64_t bc::EncodeBC1(const std::uint8_t* rgba, std::uint32_t width, std::uint32_t height,
+                            std::uint8_t* out) {
+    std::uint64_t err { 0 };
+    Block         block;
+    for (uint32_t by = 0; by < (height + 3) / 4; by++) {
+        for (uint32_t bx = 0; bx < (width + 3) / 4; bx++) {
+            LoadBlock(rgba, width, height, bx, by, block);
+            err += (std::uint64_t)EncodeColor(block, out);
+            out += BC1_BLOCK_SIZE;
+        }
+    }
+    return err;
+}
+
+std::uint64_t bc::EncodeBC3(const std::uint8_t* rgba, std::uint32_t width, std::uint32_t height,
+                            std::uint8_t* out) {
+    std::uint64_t err { 0 };
+    Block         block;
+    for (uint32_t by = 0; by < (height + 3) / 4; by++) {
+        for (uint32_t bx = 0; bx < (width + 3) / 4; bx++) {
+            LoadBlock(rgba, width, height, bx, by, block);
+            err += (std::uint64_t)EncodeAlpha(block, out);
+            err += (std::uint64_t)EncodeColor(block, out + 8);
+            out += BC3_BLOCK_SIZE;
+        }
+    }
+    return err;
+}
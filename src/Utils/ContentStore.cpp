@@ -0,0 +1,64 @@
+#include "ContentStore.hpp"
+
+using namespace utils;
+
+ContentStore& ContentStore::Global() {
+    static ContentStore store { 256u * 1024u * 1024u };
+    return store;
+}
+
+std::shared_ptr<const void> ContentStore::get(std::string_view key, const std::type_info& type) {
+    std::unique_lock lock(m_mutex);
+    auto             it = m_entries.find(key);
+    if (it == m_entries.end() || *it->second->type != type) return nullptr;
+    m_lru.splice(m_lru.begin(), m_lru, it->second);
+    return it->second->value;
+}
+
+void ContentStore::put(std::string_view key, std::shared_ptr<const void> value,
+                       const std::type_info& type, std::size_t size) {
+    if (! value) return;
+    std::unique_lock lock(m_mutex);
+    if (size > m_budget) return;
+    if (auto it = m_entries.find(key); it != m_entries.end()) {
+        m_used -= it->second->size;
+        m_lru.erase(it->second);
+        m_entries.erase(it);
+    }
+    m_lru.push_front({ std::string(key), std::move(value), &type, size });
+    m_entries.emplace(m_lru.front().key, m_lru.begin());
+    m_used += size;
+    evict();
+}
+
+void ContentStore::evict() {
+    while (m_used > m_budget && ! m_lru.empty()) {
+        auto& last = m_lru.back();
+        m_used -= last.size;
+        m_entries.erase(last.key);
+        m_lru.pop_back();
+    }
+}
+
+void ContentStore::SetBudget(std::size_t budget) {
+    std::unique_lock lock(m_mutex);
+    m_budget = budget;
+    evict();
+}
+
+std::size_t ContentStore::Budget() const {
+    std::unique_lock lock(m_mutex);
+    return m_budget;
+}
+
+std::size_t ContentStore::Used() const {
+    std::unique_lock lock(m_mutex);
+    return m_used;
+}
+
+void ContentStore::Clear() {
+    std::unique_lock lock(m_mutex);
+    m_entries.clear();
+    m_lru.clear();
+    m_used = 0;
+}
@@ -0,0 +1,70 @@
+#include "ThreadPool.hpp"
+
+#include <string>
+#include <algorithm>
+
+#include "Trace.h"
+
+using namespace utils;
+
+ThreadPool::ThreadPool(std::size_t num_threads) {
+    num_threads = std::max<std::size_t>(num_threads, 1);
+    m_threads.reserve(num_threads);
+    for (std::size_t i = 0; i < num_threads; i++) {
+        m_threads.emplace_back([this, i]() {
+            work(i);
+        });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::unique_lock lock(m_mutex);
+        m_stop = true;
+    }
+    m_cond.notify_all();
+    for (auto& t : m_threads) t.join();
+}
+
+ThreadPool& ThreadPool::Global() {
+    static ThreadPool pool(std::max(2u, std::thread::hardware_concurrency()) - 1u);
+    return pool;
+}
+
+void ThreadPool::enqueue(std::function<void()>&& job) {
+    {
+        std::unique_lock lock(m_mutex);
+        m_jobs.emplace_back(std::move(job));
+    }
+    m_cond.notify_one();
+}
+
+bool ThreadPool::RunOne() {
+    std::function<void()> job;
+    {
+        std::unique_lock lock(m_mutex);
+        if (m_jobs.empty()) return false;
+        job = std::move(m_jobs.front());
+        m_jobs.pop_front();
+    }
+    job();
+    return true;
+}
+
+void ThreadPool::work(std::size_t index) {
+    wallpaper::trace::SetThreadName("worker " + std::to_string(index));
+    while (true) {
+        std::function<void()> job;
+        {
+            std::unique_lock lock(m_mutex);
+            m_cond.wait(lock, [this]() {
+                return m_stop || ! m_jobs.empty();
+            });
+            // finish queued jobs before stop
+            if (m_jobs.empty()) return;
+            job = std::move(m_jobs.front());
+            m_jobs.pop_front();
+        }
+        job();
+    }
+}
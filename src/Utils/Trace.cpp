@@ -0,0 +1,154 @@
+#include "Trace.h"
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "Logging.h"
+
+using namespace wallpaper;
+using namespace wallpaper::trace;
+
+std::atomic<bool> trace::detail::g_enabled { false };
+
+namespace
+{
+struct Event {
+    const char* name;
+    uint64_t    begin;
+    uint64_t    end;
+};
+
+// single writer (the owning thread), read by Stop()
+struct ThreadBuffer {
+    constexpr static size_t CAPACITY { 1u << 16 };
+
+    std::unique_ptr<Event[]> events { new Event[CAPACITY] };
+    std::atomic<size_t>      count { 0 };
+    std::atomic<uint64_t>    session { 0 };
+    std::atomic<size_t>      dropped { 0 };
+    uint32_t                 tid { 0 };
+    std::string              name;
+};
+
+const auto g_epoch = std::chrono::steady_clock::now();
+
+std::mutex                                 g_mutex;
+std::vector<std::shared_ptr<ThreadBuffer>> g_buffers;
+std::atomic<uint64_t>                      g_session { 0 };
+std::string                                g_path;
+
+ThreadBuffer& LocalBuffer() {
+    thread_local std::shared_ptr<ThreadBuffer> buf;
+    if (! buf) {
+        buf = std::make_shared<ThreadBuffer>();
+        std::unique_lock lock(g_mutex);
+        buf->tid = (uint32_t)g_buffers.size() + 1;
+        g_buffers.push_back(buf);
+    }
+    return *buf;
+}
+
+void WriteEscaped(FILE* f, std::string_view str) {
+    for (char c : str) {
+        if (c == '"' || c == '\\') std::fputc('\\', f);
+        if ((unsigned char)c < 0x20) continue;
+        std::fputc(c, f);
+    }
+}
+} // namespace
+
+uint64_t trace::detail::Now() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now() - g_epoch)
+               .count() +
+           1;
+}
+
+void trace::detail::Record(const char* name, uint64_t begin, uint64_t end) {
+    auto&    buf     = LocalBuffer();
+    uint64_t session = g_session.load(std::memory_order_acquire);
+    if (buf.session.load(std::memory_order_relaxed) != session) {
+        buf.count.store(0, std::memory_order_relaxed);
+        buf.dropped.store(0, std::memory_order_relaxed);
+        buf.session.store(session, std::memory_order_release);
+    }
+    size_t n = buf.count.load(std::memory_order_relaxed);
+    if (n >= ThreadBuffer::CAPACITY) {
+        buf.dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    buf.events[n] = Event { name, begin, end };
+    buf.count.store(n + 1, std::memory_order_release);
+}
+
+void trace::SetThreadName(std::string_view name) {
+    auto&            buf = LocalBuffer();
+    std::unique_lock lock(g_mutex);
+    buf.name.assign(name);
+}
+
+void trace::Start(std::string_view out_path) {
+    std::unique_lock lock(g_mutex);
+    g_path.assign(out_path);
+    g_session.fetch_add(1, std::memory_order_acq_rel);
+    detail::g_enabled.store(true, std::memory_order_release);
+    LOG_INFO("trace started, output: %s", g_path.c_str());
+}
+
+bool trace::IsRunning() { return Enabled(); }
+
+bool trace::Stop() {
+    if (! detail::g_enabled.exchange(false, std::memory_order_acq_rel)) return false;
+
+    std::unique_lock lock(g_mutex);
+    FILE*            f = std::fopen(g_path.c_str(), "wb");
+    if (f == nullptr) {
+        LOG_ERROR("can't open trace file \"%s\"", g_path.c_str());
+        return false;
+    }
+
+    uint64_t session = g_session.load(std::memory_order_acquire);
+    size_t   total { 0 }, dropped { 0 };
+    bool     first { true };
+    auto     sep = [&]() {
+        std::fputs(first ? "\n" : ",\n", f);
+        first = false;
+    };
+
+    std::fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", f);
+    for (auto& buf : g_buffers) {
+        if (! buf->name.empty()) {
+            sep();
+            std::fprintf(f,
+                         "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%u,"
+                         "\"args\":{\"name\":\"",
+                         buf->tid);
+            WriteEscaped(f, buf->name);
+            std::fputs("\"}}", f);
+        }
+        if (buf->session.load(std::memory_order_acquire) != session) continue;
+
+        size_t n = buf->count.load(std::memory_order_acquire);
+        for (size_t i = 0; i < n; i++) {
+            const auto& e = buf->events[i];
+            sep();
+            std::fputs("{\"ph\":\"X\",\"cat\":\"wp\",\"name\":\"", f);
+            WriteEscaped(f, e.name);
+            std::fprintf(f,
+                         "\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                         buf->tid,
+                         (double)e.begin / 1000.0,
+                         (double)(e.end - e.begin) / 1000.0);
+        }
+        total += n;
+        dropped += buf->dropped.load(std::memory_order_relaxed);
+    }
+    std::fputs("\n]}\n", f);
+    std::fclose(f);
+
+    LOG_INFO("trace written to %s, %zu events, %zu dropped", g_path.c_str(), total, dropped);
+    return true;
+}
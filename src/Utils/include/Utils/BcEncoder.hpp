@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace utils
+{
+
+// block compression of rgba8 images, rows tightly packed
+// extents not a multiple of 4 are padded by repeating the edge pixels
+// encoded blocks are row major, as vulkan expects them
+namespace bc
+{
+
+constexpr std::size_t BC1_BLOCK_SIZE { 8 };
+constexpr std::size_t BC3_BLOCK_SIZE { 16 };
+
+std::size_t CompressedSize(std::uint32_t width, std::uint32_t height, std::size_t block_size);
+
+// true if no pixel has alpha below 255
+bool IsOpaque(const std::uint8_t* rgba, std::size_t pixel_count);
+
+// alpha is dropped, for opaque images
+// returns the sum of squared errors of all channels
+std::uint64_t EncodeBC1(const std::uint8_t* rgba, std::uint32_t width, std::uint32_t height,
+                        std::uint8_t* out);
+std::uint64_t EncodeBC3(const std::uint8_t* rgba, std::uint32_t width, std::uint32_t height,
+                        std::uint8_t* out);
+
+} // namespace bc
+} // namespace utils
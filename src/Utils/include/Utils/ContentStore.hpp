@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <typeinfo>
+
+#include "Core/NoCopyMove.hpp"
+#include "Core/MapSet.hpp"
+
+namespace utils
+{
+
+// content addressed values shared by all wallpapers in the process
+// key is a kind prefix plus the sha of the raw bytes, eg. "tex:<sha1>"
+// least recently used values are dropped when over the byte budget
+// dropped values stay alive while still referenced
+class ContentStore : NoCopy, NoMove {
+public:
+    explicit ContentStore(std::size_t budget): m_budget(budget) {}
+    ~ContentStore() = default;
+
+    static ContentStore& Global();
+
+    template<typename T>
+    std::shared_ptr<const T> Get(std::string_view key) {
+        return std::static_pointer_cast<const T>(get(key, typeid(T)));
+    }
+    // size: bytes of memory held by value
+    template<typename T>
+    void Put(std::string_view key, std::shared_ptr<const T> value, std::size_t size) {
+        put(key, std::move(value), typeid(T), size);
+    }
+
+    // 0 disables the store
+    void        SetBudget(std::size_t);
+    std::size_t Budget() const;
+    std::size_t Used() const;
+    void        Clear();
+
+private:
+    struct Entry {
+        std::string                 key;
+        std::shared_ptr<const void> value;
+        const std::type_info*       type;
+        std::size_t                 size;
+    };
+    using List = std::list<Entry>;
+
+    std::shared_ptr<const void> get(std::string_view key, const std::type_info&);
+    void put(std::string_view key, std::shared_ptr<const void>, const std::type_info&, std::size_t);
+    void evict();
+
+    mutable std::mutex m_mutex;
+    std::size_t        m_budget;
+    std::size_t        m_used { 0 };
+    // front is most recently used
+    List                                     m_lru;
+    wallpaper::StringHashMap<List::iterator> m_entries;
+};
+
+} // namespace utils
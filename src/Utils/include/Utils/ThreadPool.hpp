@@ -0,0 +1,63 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "Core/NoCopyMove.hpp"
+
+namespace utils
+{
+
+// fixed size worker pool for loading jobs (io, decode, compile)
+class ThreadPool : NoCopy, NoMove {
+public:
+    explicit ThreadPool(std::size_t num_threads);
+    ~ThreadPool();
+
+    // shared by all wallpapers in the process
+    static ThreadPool& Global();
+
+    template<typename F, typename R = std::invoke_result_t<std::decay_t<F>>>
+    std::future<R> Post(F&& func) {
+        auto task = std::make_shared<std::packaged_task<R()>>(std::forward<F>(func));
+        auto res  = task->get_future();
+        enqueue([task]() {
+            (*task)();
+        });
+        return res;
+    }
+
+    // wait a future, running queued jobs meanwhile
+    // safe to call from a worker, a job waiting on other jobs can't deadlock the pool
+    template<typename TFuture>
+    void Wait(const TFuture& future) {
+        while (future.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            if (! RunOne()) future.wait_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    // run one queued job on the calling thread, false if queue is empty
+    bool RunOne();
+
+    std::size_t Size() const { return m_threads.size(); }
+
+private:
+    void enqueue(std::function<void()>&&);
+    void work(std::size_t index);
+
+    std::mutex                        m_mutex;
+    std::condition_variable           m_cond;
+    std::deque<std::function<void()>> m_jobs;
+    std::vector<std::thread>          m_threads;
+    bool                              m_stop { false };
+};
+
+} // namespace utils
@@ -0,0 +1,56 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace wallpaper
+{
+namespace trace
+{
+
+// scoped zones, exported as chrome trace-event json (chrome://tracing, ui.perfetto.dev)
+// zone names must be string literals, only the pointer is recorded
+
+namespace detail
+{
+extern std::atomic<bool> g_enabled;
+
+uint64_t Now();
+void     Record(const char* name, uint64_t begin, uint64_t end);
+} // namespace detail
+
+inline bool Enabled() { return detail::g_enabled.load(std::memory_order_relaxed); }
+
+// start a new session, events recorded before are dropped
+void Start(std::string_view out_path);
+// stop the session and write the json to the path given to Start
+bool Stop();
+bool IsRunning();
+
+// name shown for the calling thread
+void SetThreadName(std::string_view);
+
+class Scope {
+public:
+    explicit Scope(const char* name) noexcept: m_name(name) {
+        if (Enabled()) m_begin = detail::Now();
+    }
+    ~Scope() {
+        if (m_begin != 0 && Enabled()) detail::Record(m_name, m_begin, detail::Now());
+    }
+    Scope(const Scope&)            = delete;
+    Scope& operator=(const Scope&) = delete;
+
+private:
+    const char* m_name;
+    uint64_t    m_begin { 0 };
+};
+
+} // namespace trace
+} // namespace wallpaper
+
+#define WP_TRACE_CONCAT_IMPL(a, b) a##b
+#define WP_TRACE_CONCAT(a, b)      WP_TRACE_CONCAT_IMPL(a, b)
+#define WP_TRACE_SCOPE(name) \
+    ::wallpaper::trace::Scope WP_TRACE_CONCAT(_wp_trace_scope_, __LINE__) { name }
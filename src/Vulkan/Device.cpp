@@ -1,6 +1,11 @@
 #include "Device.hpp"
 
+#include <algorithm>
+#include <array>
+#include <cstring>
+
 #include "Utils/Logging.h"
+#include "Fs/VFS.h"
 #include "GraphicsPipeline.hpp"
 
 using namespace wallpaper::vulkan;
@@ -16,6 +21,19 @@ void EnumateDeviceExts(const vvk::PhysicalDevice& gpu, wallpaper::Set<std::strin
     }
 }
 
+#define PIPELINE_CACHE_PATH "/cache/pipelinecache"
+
+// data of another driver or gpu is only rejected by some drivers after a slow check
+bool MatchPipelineCache(std::span<const std::byte> data, const VkPhysicalDeviceProperties& props) {
+    VkPipelineCacheHeaderVersionOne header;
+    if (data.size() < sizeof(header)) return false;
+    std::memcpy(&header, data.data(), sizeof(header));
+    return header.headerSize >= sizeof(header) &&
+           header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+           header.vendorID == props.vendorID && header.deviceID == props.deviceID &&
+           std::memcmp(header.pipelineCacheUUID, props.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
 } // namespace
 
 bool Device::CheckGPU(vvk::PhysicalDevice gpu, std::span<const Extension> exts, VkSurfaceKHR surface) {
@@ -71,6 +89,26 @@ std::vector<VkDeviceQueueCreateInfo> Device::ChooseDeviceQueue(VkSurfaceKHR surf
         };
         queues.push_back(info);
     }
+    m_transfer_queue.family_index = m_graphics_queue.family_index;
+    index                         = 0;
+    for (auto& prop : props) {
+        // dedicated copy engine, needs to copy any extent
+        auto& gran = prop.minImageTransferGranularity;
+        if ((prop.queueFlags & VK_QUEUE_TRANSFER_BIT) &&
+            ! (prop.queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)) &&
+            gran.width == 1 && gran.height == 1 && gran.depth == 1) {
+            m_transfer_queue.family_index = index;
+            VkDeviceQueueCreateInfo info {
+                .sType            = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+                .queueFamilyIndex = index,
+                .queueCount       = 1,
+                .pQueuePriorities = &defaultQueuePriority,
+            };
+            queues.push_back(info);
+            break;
+        }
+        index++;
+    };
     m_present_queue.family_index = graphic_indexs.front();
     if (surface) {
         index = 0;
@@ -120,19 +158,29 @@ bool Device::Create(Instance& inst, std::span<const Extension> exts, VkExtent2D
         tested_exts.begin(), tested_exts.end(), tested_exts_c.begin(), [](const auto& s) {
             return s.c_str();
         });
+    // optional features, enabled when supported
+    VkPhysicalDeviceFeatures2 features {
+        .sType    = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+        .pNext    = nullptr,
+        .features = {},
+    };
+    features.features.textureCompressionBC = inst.gpu().GetFeatures().textureCompressionBC;
+
     bool rq_surface = ! inst.offscreen();
     VVK_CHECK_BOOL_RE(vvk::Device::Create(device.m_device,
                                           *device.m_gpu,
                                           device.ChooseDeviceQueue(*inst.surface()),
                                           tested_exts_c,
-                                          nullptr,
+                                          &features,
                                           device.dld));
+    device.m_features = features.features;
 
     // VK_CHECK_RESULT_BOOL_RE(CreateDevice(inst, device.ChooseDeviceQueue(inst.surface()),
     // tested_exts_c, &device.m_device));
 
     device.m_graphics_queue.handle = device.m_device.GetQueue(device.m_graphics_queue.family_index);
     device.m_present_queue.handle  = device.m_device.GetQueue(device.m_present_queue.family_index);
+    device.m_transfer_queue.handle = device.m_device.GetQueue(device.m_transfer_queue.family_index);
 
     if (rq_surface) {
         if (! Swapchain::Create(device, *inst.surface(), extent, device.m_swapchain)) {
@@ -147,12 +195,18 @@ bool Device::Create(Instance& inst, std::span<const Extension> exts, VkExtent2D
                                        .queueFamilyIndex = device.m_graphics_queue.family_index };
         VVK_CHECK_BOOL_RE(device.m_device.CreateCommandPool(info, device.m_command_pool));
     }
+    {
+        VkPipelineCacheCreateInfo info { .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO };
+        VVK_CHECK_BOOL_RE(device.m_device.CreatePipelineCache(info, device.m_pipeline_cache));
+    }
     {
         VmaAllocatorCreateInfo allocatorInfo = {};
         allocatorInfo.vulkanApiVersion       = WP_VULKAN_VERSION;
         allocatorInfo.physicalDevice         = *device.m_gpu;
         allocatorInfo.device                 = *device.m_device;
         allocatorInfo.instance               = *inst.inst();
+        if (device.supportExt(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME))
+            allocatorInfo.flags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
         VVK_CHECK_BOOL_RE(vvk::CreateVmaAllocator(allocatorInfo, device.m_allocator));
     }
     device.m_tex_cache = std::make_unique<TextureCache>(device);
@@ -165,7 +219,93 @@ VkDeviceSize Device::GetUsage() const {
     return budget.usage;
 }
 
-void Device::Destroy() { VVK_CHECK(m_device.WaitIdle()); }
+Device::MemoryBudget Device::GetBudget() const {
+    const VkPhysicalDeviceMemoryProperties* props { nullptr };
+    vmaGetMemoryProperties(*m_allocator, &props);
+
+    std::array<VmaBudget, VK_MAX_MEMORY_HEAPS> budgets {};
+    vmaGetHeapBudgets(*m_allocator, budgets.data());
+
+    MemoryBudget out;
+    for (uint32_t i = 0; i < props->memoryHeapCount; i++) {
+        if (! (props->memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)) continue;
+        out.usage += budgets[i].usage;
+        out.budget += budgets[i].budget;
+    }
+    return out;
+}
+
+void Device::LoadPipelineCache(fs::VFS& vfs) {
+    if (! vfs.IsMounted("cache") || ! mergeSavedPipelineCache(vfs)) return;
+    std::vector<uint8_t> merged;
+    VVK_CHECK_VOID_RE(m_pipeline_cache.GetData(merged));
+    m_pipeline_cache_size = merged.size();
+}
+
+void Device::SavePipelineCache(fs::VFS& vfs) {
+    if (! vfs.IsMounted("cache")) return;
+    std::vector<uint8_t> data;
+    VVK_CHECK_VOID_RE(m_pipeline_cache.GetData(data));
+    if (data.size() == m_pipeline_cache_size) return;
+    // pipelines other scenes saved since the load are kept
+    if (mergeSavedPipelineCache(vfs)) {
+        VVK_CHECK_VOID_RE(m_pipeline_cache.GetData(data));
+    }
+
+    auto tmp_path = fs::TempPath(PIPELINE_CACHE_PATH);
+    {
+        auto file = vfs.OpenW(tmp_path);
+        if (! file) return;
+        file->Write(data.data(), data.size());
+    }
+    // a crash while writing leaves the old cache
+    if (vfs.Rename(tmp_path, PIPELINE_CACHE_PATH)) m_pipeline_cache_size = data.size();
+}
+
+bool Device::mergeSavedPipelineCache(fs::VFS& vfs) {
+    if (! vfs.Contains(PIPELINE_CACHE_PATH)) return false;
+    auto file = vfs.OpenMapped(PIPELINE_CACHE_PATH);
+    if (! file) return false;
+    auto data = file->Data();
+    if (! MatchPipelineCache(data, m_gpu.GetProperties())) {
+        LOG_INFO("pipeline cache is from another driver or gpu, ignored");
+        return false;
+    }
+
+    vvk::PipelineCache        saved;
+    VkPipelineCacheCreateInfo info { .sType           = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+                                     .initialDataSize = data.size(),
+                                     .pInitialData    = data.data() };
+    VVK_CHECK_BOOL_RE(m_device.CreatePipelineCache(info, saved));
+    VkPipelineCache src = *saved;
+    VVK_CHECK_BOOL_RE(m_pipeline_cache.Merge(src));
+    return true;
+}
+
+void Device::Destroy() {
+    VVK_CHECK(m_device.WaitIdle());
+    std::unique_lock lock(m_retire_mutex);
+    m_retired.clear();
+}
+
+void Device::retire(std::shared_ptr<void> object) const {
+    std::unique_lock lock(m_retire_mutex);
+    m_retired.push_back({ m_frame, std::move(object) });
+}
+
+void Device::SetFrame(u64 recording, u64 completed) {
+    // destroyed outside the lock
+    std::vector<Retired> done;
+    {
+        std::unique_lock lock(m_retire_mutex);
+        m_frame = recording;
+        auto it = std::partition(m_retired.begin(), m_retired.end(), [completed](auto& r) {
+            return r.frame >= completed;
+        });
+        std::move(it, m_retired.end(), std::back_inserter(done));
+        m_retired.erase(it, m_retired.end());
+    }
+}
 
 Device::Device(): m_tex_cache(std::make_unique<TextureCache>(*this)) {}
 Device::~Device() {};
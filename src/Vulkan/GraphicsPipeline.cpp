@@ -237,7 +237,8 @@ bool GraphicsPipeline::create(const Device& device, vvk::RenderPass& pass,
         .layout              = *pipeline.layout,
         .renderPass          = *pass,
     };
-    VVK_CHECK_BOOL_RE(device.handle().CreateGraphicsPipeline(create, pipeline.handle));
+    VVK_CHECK_BOOL_RE(
+        device.handle().CreateGraphicsPipeline(create, pipeline.handle, *device.pipeline_cache()));
     pipeline.pass = std::move(pass);
     return true;
 }
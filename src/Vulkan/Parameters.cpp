@@ -57,9 +57,10 @@ ExImageParameters& ExImageParameters::operator=(ExImageParameters&& o) noexcept
 
 ImageSlots::ImageSlots()  = default;
 ImageSlots::~ImageSlots() = default;
-ImageSlots::ImageSlots(ImageSlots&& o) noexcept: slots(std::move(o.slots)) {}
+ImageSlots::ImageSlots(ImageSlots&& o) noexcept: slots(std::move(o.slots)), format(o.format) {}
 ImageSlots& ImageSlots::operator=(ImageSlots&& o) noexcept {
-    slots = std::move(o.slots);
+    slots  = std::move(o.slots);
+    format = o.format;
     return *this;
 }
 
@@ -0,0 +1,173 @@
+#include "ResidencyManager.hpp"
+
+#include <algorithm>
+
+#include "Utils/Logging.h"
+
+using namespace wallpaper;
+using namespace wallpaper::vulkan;
+
+namespace
+{
+// frames between plans, lets the driver budget catch up with freed memory
+constexpr u64 PLAN_INTERVAL { 30 };
+// sprite slot not shown for this long is evicted
+constexpr u64 EVICT_IDLE_FRAMES { 600 };
+// sampled in less than one of this many frames
+constexpr u64 RARE_SAMPLE_FRAMES { 4 };
+// only large textures lose mips, and not below this extent
+constexpr usize LARGE_SIZE { 1024u * 1024u };
+constexpr u32   MIN_EXTENT { 256 };
+constexpr usize MAX_DECISIONS_PER_PLAN { 4 };
+constexpr usize DECISION_LOG_SIZE { 64 };
+
+constexpr std::string_view ToString(ResidencyAction a) {
+    switch (a) {
+    case ResidencyAction::DROP_MIPS: return "drop mips";
+    case ResidencyAction::EVICT_SLOT: return "evict slot";
+    }
+    return "";
+}
+} // namespace
+
+ResidencyManager::ResidencyManager()  = default;
+ResidencyManager::~ResidencyManager() = default;
+
+void ResidencyManager::SetBudget(usize bytes) { m_budget = bytes; }
+
+void ResidencyManager::Track(std::string_view key, usize slot, const SlotInfo& info) {
+    auto it = m_slots.find(key);
+    if (it == m_slots.end()) it = m_slots.emplace(std::string(key), std::vector<SlotInfo> {}).first;
+    auto& slots = it->second;
+    if (slots.size() <= slot) slots.resize(slot + 1);
+    slots[slot]         = info;
+    slots[slot].tracked = m_frame;
+}
+
+void ResidencyManager::Clear() {
+    m_slots.clear();
+    m_next_plan = 0;
+}
+
+void ResidencyManager::MarkUsed(std::string_view key, usize slot) {
+    auto it = m_slots.find(key);
+    if (it == m_slots.end() || slot >= it->second.size()) return;
+    auto& s     = it->second[slot];
+    s.last_used = m_frame;
+    s.uses++;
+}
+
+std::vector<ResidencyDecision> ResidencyManager::Plan(u64 frame, usize usage, usize budget) {
+    m_frame = frame;
+
+    usize limit = budget;
+    if (m_budget != 0) limit = budget == 0 ? m_budget : std::min(m_budget, budget);
+
+    std::vector<ResidencyDecision> out;
+    if (limit == 0 || usage <= limit || frame < m_next_plan) return out;
+    m_next_plan = frame + PLAN_INTERVAL;
+
+    // free down to 90% so it doesn't trigger again right away
+    usize excess = usage - limit / 10 * 9;
+
+    struct Candidate {
+        ResidencyDecision decision;
+        // evict first, then rarely sampled, then by size
+        bool rare;
+    };
+    std::vector<Candidate> cands;
+    for (auto& [key, slots] : m_slots) {
+        for (usize i = 0; i < slots.size(); i++) {
+            auto& s = slots[i];
+            if (s.render_target || ! s.can_shrink || s.evicted || s.size == 0) continue;
+
+            u64 since = std::max(s.last_used, s.tracked);
+            u64 idle  = frame > since ? frame - since : 0;
+            u64 age   = frame > s.tracked ? frame - s.tracked : 0;
+
+            if (slots.size() > 1 && idle >= EVICT_IDLE_FRAMES) {
+                cands.push_back({ { .action = ResidencyAction::EVICT_SLOT,
+                                    .key    = key,
+                                    .slot   = i,
+                                    .frame  = frame,
+                                    .freed  = s.size - s.size / 16 },
+                                  true });
+            } else if (s.size >= LARGE_SIZE && std::min(s.width, s.height) > MIN_EXTENT) {
+                bool rare = s.uses * RARE_SAMPLE_FRAMES < age;
+                cands.push_back({ { .action = ResidencyAction::DROP_MIPS,
+                                    .key    = key,
+                                    .slot   = i,
+                                    .frame  = frame,
+                                    .freed  = s.size / 4 * 3 },
+                                  rare });
+            }
+        }
+    }
+    std::sort(cands.begin(), cands.end(), [](const Candidate& a, const Candidate& b) {
+        if (a.decision.action != b.decision.action)
+            return a.decision.action == ResidencyAction::EVICT_SLOT;
+        if (a.rare != b.rare) return a.rare;
+        return a.decision.freed > b.decision.freed;
+    });
+
+    usize freed { 0 };
+    for (auto& c : cands) {
+        if (freed >= excess || out.size() >= MAX_DECISIONS_PER_PLAN) break;
+        freed += c.decision.freed;
+        out.push_back(std::move(c.decision));
+    }
+    return out;
+}
+
+void ResidencyManager::Applied(const ResidencyDecision& decision, const SlotInfo& info) {
+    auto it = m_slots.find(decision.key);
+    if (it != m_slots.end() && decision.slot < it->second.size()) {
+        auto& s      = it->second[decision.slot];
+        usize old    = s.size;
+        s.size       = info.size;
+        s.width      = info.width;
+        s.height     = info.height;
+        s.levels     = info.levels;
+        s.can_shrink = info.can_shrink;
+        s.evicted    = decision.action == ResidencyAction::EVICT_SLOT;
+
+        auto& logged = m_decisions.emplace_back(decision);
+        logged.freed = old > info.size ? old - info.size : 0;
+        if (m_decisions.size() > DECISION_LOG_SIZE) m_decisions.pop_front();
+
+        LOG_INFO("residency: %s \"%s\" slot %zu, freed %zu KiB",
+                 ToString(decision.action).data(),
+                 decision.key.c_str(),
+                 decision.slot,
+                 logged.freed / 1024u);
+        if (m_callback) m_callback(logged);
+    }
+}
+
+const ResidencyManager::SlotInfo* ResidencyManager::Find(std::string_view key, usize slot) const {
+    auto it = m_slots.find(key);
+    if (it == m_slots.end() || slot >= it->second.size()) return nullptr;
+    return &it->second[slot];
+}
+
+usize ResidencyManager::TextureBytes() const {
+    usize total { 0 };
+    for (auto& [key, slots] : m_slots) {
+        for (auto& s : slots)
+            if (! s.render_target) total += s.size;
+    }
+    return total;
+}
+
+usize ResidencyManager::RenderTargetBytes() const {
+    usize total { 0 };
+    for (auto& [key, slots] : m_slots) {
+        for (auto& s : slots)
+            if (s.render_target) total += s.size;
+    }
+    return total;
+}
+
+void ResidencyManager::SetDecisionCallback(std::function<void(const ResidencyDecision&)> cb) {
+    m_callback = std::move(cb);
+}
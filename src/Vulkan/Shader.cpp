@@ -12,6 +12,7 @@
 #include "Core/StringHelper.hpp"
 #include "Utils/Sha.hpp"
 #include "Core/MapSet.hpp"
+#include "Fs/BinaryReader.h"
 #include <SPIRV-Reflect/spirv_reflect.h>
 
 using namespace wallpaper;
@@ -131,6 +132,35 @@ inline i32 GetTypeNum(const glslang::TType* type) {
     if (type->isMatrix()) num *= type->getMatrixCols() * type->getMatrixRows();
     return num;
 }
+
+// little endian, as read by fs::BinaryReader
+class ReflectWriter {
+public:
+    explicit ReflectWriter(std::vector<uint8_t>& out): m_out(out) {}
+
+    void u32(uint32_t x) {
+#ifdef WP_BIG_ENDIAN
+        x = fs::bswap<uint32_t>(x);
+#endif
+        auto* p = (const uint8_t*)&x;
+        m_out.insert(m_out.end(), p, p + sizeof(x));
+    }
+    void str(std::string_view s) {
+        u32((uint32_t)s.size());
+        m_out.insert(m_out.end(), s.begin(), s.end());
+    }
+
+private:
+    std::vector<uint8_t>& m_out;
+};
+
+std::string ReadReflectStr(fs::BinaryReader& r) {
+    auto bytes = r.ReadBytes(r.ReadUint32());
+    return std::string((const char*)bytes.data(), bytes.size());
+}
+
+constexpr uint32_t REFLECT_VERSION { 1 };
+
 } // namespace
 const TBuiltInResource wallpaper::vulkan::DefaultTBuiltInResource {
     .maxLights =  32,
@@ -481,3 +511,102 @@ VkFormat wallpaper::vulkan::ToVkType(glslang::TBasicType type, size_t size) {
     return VK_FORMAT_UNDEFINED;
 #undef FORMAT_SWITCH
 }
+
+/*
+    u32 version, stage count, stage of each code
+    u32 block count
+        block: i32 index, u32 size, name, member count
+            member: name, i32 block index, u32 offset, size, num
+    u32 binding count
+        binding: name, u32 binding, type, count, stage flags
+    u32 input count
+        input: name, u32 location, format
+    strings are u32 length and bytes
+*/
+std::vector<uint8_t> wallpaper::vulkan::SaveReflect(std::span<const Uni_ShaderSpv> spvs,
+                                                    const ShaderReflected&         ref) {
+    std::vector<uint8_t> out;
+    ReflectWriter        w(out);
+    w.u32(REFLECT_VERSION);
+    w.u32((uint32_t)spvs.size());
+    for (const auto& spv : spvs) w.u32((uint32_t)spv->stage);
+
+    w.u32((uint32_t)ref.blocks.size());
+    for (const auto& block : ref.blocks) {
+        w.u32((uint32_t)block.index);
+        w.u32(block.size);
+        w.str(block.name);
+        w.u32((uint32_t)block.member_map.size());
+        for (const auto& [name, m] : block.member_map) {
+            w.str(name);
+            w.u32((uint32_t)m.block_index);
+            w.u32(m.offset);
+            w.u32((uint32_t)m.size);
+            w.u32((uint32_t)m.num);
+        }
+    }
+    w.u32((uint32_t)ref.binding_map.size());
+    for (const auto& [name, b] : ref.binding_map) {
+        w.str(name);
+        w.u32(b.binding);
+        w.u32((uint32_t)b.descriptorType);
+        w.u32(b.descriptorCount);
+        w.u32(b.stageFlags);
+    }
+    w.u32((uint32_t)ref.input_location_map.size());
+    for (const auto& [name, input] : ref.input_location_map) {
+        w.str(name);
+        w.u32(input.location);
+        w.u32((uint32_t)input.format);
+    }
+    return out;
+}
+
+bool wallpaper::vulkan::LoadReflect(std::span<const uint8_t>            data,
+                                    std::span<const std::vector<uint>> codes,
+                                    std::vector<Uni_ShaderSpv>& spvs, ShaderReflected& ref) {
+    fs::BinaryReader r(std::as_bytes(data));
+    if (r.ReadUint32() != REFLECT_VERSION || r.ReadUint32() != codes.size()) return false;
+
+    spvs.clear();
+    for (const auto& code : codes) {
+        Uni_ShaderSpv spv = std::make_unique<ShaderSpv>();
+        spv->stage        = (ShaderType)r.ReadUint32();
+        spv->spirv        = code;
+        spvs.emplace_back(std::move(spv));
+    }
+
+    ref = {};
+    // every entry is at least 4 bytes, bounds the counts of broken data
+    uint32_t block_count = r.ReadUint32();
+    if (block_count > r.Remaining()) return false;
+    ref.blocks.resize(block_count);
+    for (auto& block : ref.blocks) {
+        block.index           = (int)r.ReadUint32();
+        block.size            = r.ReadUint32();
+        block.name            = ReadReflectStr(r);
+        uint32_t member_count = r.ReadUint32();
+        for (uint32_t i = 0; i < member_count && r.ok(); i++) {
+            auto& m       = block.member_map[ReadReflectStr(r)];
+            m.block_index = (int)r.ReadUint32();
+            m.offset      = r.ReadUint32();
+            m.size        = r.ReadUint32();
+            m.num         = r.ReadUint32();
+        }
+    }
+    uint32_t binding_count = r.ReadUint32();
+    for (uint32_t i = 0; i < binding_count && r.ok(); i++) {
+        auto& b           = ref.binding_map[ReadReflectStr(r)];
+        b.binding         = r.ReadUint32();
+        b.descriptorType  = (VkDescriptorType)r.ReadUint32();
+        b.descriptorCount = r.ReadUint32();
+        b.stageFlags      = r.ReadUint32();
+    }
+    uint32_t input_count = r.ReadUint32();
+    for (uint32_t i = 0; i < input_count && r.ok(); i++) {
+        auto& input    = ref.input_location_map[ReadReflectStr(r)];
+        input.location = r.ReadUint32();
+        input.format   = (VkFormat)r.ReadUint32();
+    }
+    return r.ok();
+}
@@ -3,6 +3,7 @@
 #include <cstring>
 #include "Util.hpp"
 #include "Device.hpp"
+#include "Utils/Trace.h"
 
 using namespace wallpaper::vulkan;
 
@@ -12,8 +13,9 @@ using namespace wallpaper::vulkan;
         { act; }                                                             \
     }
 
-StagingBuffer::StagingBuffer(const Device& d, VkDeviceSize size, VkBufferUsageFlags usage)
-    : m_device(d), m_size_step(size), m_usage(usage) {}
+StagingBuffer::StagingBuffer(const Device& d, VkDeviceSize size, VkBufferUsageFlags usage,
+                             uint frames)
+    : m_device(d), m_size_step(size), m_usage(usage), m_frames(std::max(frames, 1u)) {}
 StagingBuffer::~StagingBuffer() {}
 
 namespace
@@ -37,14 +39,29 @@ std::optional<VmaBufferParameters> CreateGpuBuffer(VmaAllocator allocator, VkBuf
     return std::nullopt;
 }
 
+// sorted, overlapping and adjacent ranges joined
+void MergeRanges(std::vector<VkBufferCopy>& ranges) {
+    std::sort(ranges.begin(), ranges.end(), [](const auto& a, const auto& b) {
+        return a.dstOffset < b.dstOffset;
+    });
+    usize count { 0 };
+    for (const auto& r : ranges) {
+        if (count > 0) {
+            auto& last = ranges[count - 1];
+            if (last.dstOffset + last.size >= r.dstOffset) {
+                last.size = std::max(last.dstOffset + last.size, r.dstOffset + r.size) -
+                            last.dstOffset;
+                continue;
+            }
+        }
+        ranges[count++] = r;
+    }
+    ranges.resize(count);
+}
+
 void RecordCopyBuffer(const BufferParameters& dst_buf, const BufferParameters& src_buf,
-                      vvk::CommandBuffer& cmd) {
-    VkBufferCopy copy {
-        .srcOffset = 0,
-        .dstOffset = 0,
-        .size      = src_buf.req_size,
-    };
-    cmd.CopyBuffer(src_buf.handle, dst_buf.handle, copy);
+                      std::span<VkBufferCopy> regions, vvk::CommandBuffer& cmd) {
+    cmd.CopyBuffer(src_buf.handle, dst_buf.handle, regions);
 
     VkBufferMemoryBarrier in_bar {
         .sType         = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
@@ -63,20 +80,42 @@ void RecordCopyBuffer(const BufferParameters& dst_buf, const BufferParameters& s
 }
 } // namespace
 
+bool StagingBuffer::createBlockBuffers(VirtualBlock& block) {
+    block.gpu_bufs.resize(m_frames);
+    for (auto& buf : block.gpu_bufs) {
+        if (auto opt = CreateGpuBuffer(m_device.vma_allocator(), m_usage, block.size);
+            opt.has_value()) {
+            buf = std::move(opt.value());
+        } else
+            return false;
+    }
+    block.gpu_uploaded.assign(m_frames, false);
+    block.dirty.assign(m_frames, {});
+
+    if (! CreateStagingBuffer(m_device.vma_allocator(), block.size * m_frames, block.stage_buf))
+        return false;
+    void* raw { nullptr };
+    VVK_CHECK_BOOL_RE(block.stage_buf.handle.MapMemory(&raw));
+    block.stage_raw = (uint8_t*)raw;
+    return true;
+}
+
 StagingBuffer::VirtualBlock* StagingBuffer::newVirtualBlock(VkDeviceSize nsize) {
     auto it = std::find_if(m_virtual_blocks.begin(), m_virtual_blocks.end(), [nsize](auto& b) {
         return ! b.enabled && b.size >= nsize;
     });
     if (it == std::end(m_virtual_blocks)) {
-        VkDeviceSize offset = m_virtual_blocks.empty()
-                                  ? 0
-                                  : m_virtual_blocks.back().offset + m_virtual_blocks.back().size;
-
-        m_virtual_blocks.push_back({});
-        it         = m_virtual_blocks.end() - 1;
-        it->size   = nsize > m_size_step ? nsize : m_size_step;
-        it->index  = (size_t)std::distance(m_virtual_blocks.begin(), it);
-        it->offset = offset;
+        // added without touching the other blocks
+        VirtualBlock block;
+        block.size  = nsize > m_size_step ? nsize : m_size_step;
+        block.index = m_virtual_blocks.size();
+        if (! createBlockBuffers(block)) {
+            if (block.stage_raw != nullptr) block.stage_buf.handle.UnMapMemory();
+            LOG_ERROR("create buffer block failed, size: %d", block.size);
+            return nullptr;
+        }
+        m_virtual_blocks.push_back(std::move(block));
+        it = m_virtual_blocks.end() - 1;
     }
     auto& block = *it;
 
@@ -93,55 +132,34 @@ StagingBuffer::VirtualBlock* StagingBuffer::newVirtualBlock(VkDeviceSize nsize)
              m_virtual_blocks.size());
     return &block;
 }
-bool StagingBuffer::increaseBuf(VkDeviceSize nsize) {
-    if (m_stage_raw == nullptr) {
-        VVK_CHECK_BOOL_RE(mapStageBuf());
+
+StagingBuffer::VirtualBlock* StagingBuffer::refBlock(const StagingBufferRef& ref) {
+    if (ref.m_virtual_index < m_virtual_blocks.size()) {
+        auto& block = m_virtual_blocks[ref.m_virtual_index];
+        if (block.enabled) return &block;
     }
-    auto newsize = m_stage_buf.req_size + nsize;
-    // do double copy
-    std::vector<uint8_t> tmp;
-    tmp.resize(newsize);
-    memcpy(tmp.data(), m_stage_raw, m_stage_buf.req_size);
-
-    m_stage_raw = nullptr;
-    m_stage_buf.handle.UnMapMemory();
-    m_stage_buf.handle = nullptr;
-
-    if (! CreateStagingBuffer(m_device.vma_allocator(), newsize, m_stage_buf)) return false;
-    VVK_CHECK_BOOL_RE(mapStageBuf());
-    memcpy(m_stage_raw, tmp.data(), newsize);
-
-    m_gpu_buf.handle = nullptr;
-    LOG_INFO("increase buffer size: %d", nsize);
-    return true;
+    LOG_ERROR("stagingbuffer ref has a wrong block index %d", ref.m_virtual_index);
+    return nullptr;
 }
 
 bool StagingBuffer::allocate() {
-    if (! CreateStagingBuffer(m_device.vma_allocator(), m_size_step, m_stage_buf)) return false;
-    VVK_CHECK_BOOL_RE(m_stage_buf.handle.MapMemory(&m_stage_raw));
-    auto* block = newVirtualBlock(m_size_step);
-    return block != nullptr;
+    m_frame = 0;
+    return newVirtualBlock(m_size_step) != nullptr;
 }
 
 void StagingBuffer::destroy() {
-    if (m_stage_raw != nullptr) {
-        m_stage_buf.handle.UnMapMemory();
-    }
     for (auto& block : m_virtual_blocks) {
         if (block.enabled) {
             vmaClearVirtualBlock(block.handle);
             vmaDestroyVirtualBlock(block.handle);
         }
+        if (block.stage_raw != nullptr) block.stage_buf.handle.UnMapMemory();
     }
     m_virtual_blocks.clear();
-
-    m_stage_buf = {};
-    m_gpu_buf   = {};
 }
 
 bool StagingBuffer::allocateSubRef(VkDeviceSize size, StagingBufferRef& ref,
                                    VkDeviceSize alignment) {
-    VkResult                       result;
     VmaVirtualAllocationCreateInfo allocCreateInfo = {};
     allocCreateInfo.size                           = size;
     allocCreateInfo.alignment                      = alignment;
@@ -151,12 +169,13 @@ bool StagingBuffer::allocateSubRef(VkDeviceSize size, StagingBufferRef& ref,
 
     auto setRef = [&offset, &allocation, size](StagingBufferRef& ref, VirtualBlock& block) {
         ref.size   = size;
-        ref.offset = offset + block.offset;
+        ref.offset = offset;
 
         ref.m_allocation    = allocation;
         ref.m_virtual_index = block.index;
     };
 
+    // released ranges are reused by the virtual block
     for (auto& block : m_virtual_blocks) {
         if (block.enabled && block.size >= size) {
             if (auto res = vmaVirtualAllocate(block.handle, &allocCreateInfo, &allocation, &offset);
@@ -167,21 +186,10 @@ bool StagingBuffer::allocateSubRef(VkDeviceSize size, StagingBufferRef& ref,
         }
     }
 
-    auto  old_block_num = m_virtual_blocks.size();
-    auto* p_block       = newVirtualBlock(size);
+    auto* p_block = newVirtualBlock(size);
     if (p_block == nullptr) return false;
 
     auto& block = *p_block;
-    if (old_block_num < m_virtual_blocks.size()) {
-        if (! increaseBuf(block.size)) {
-            auto& block = m_virtual_blocks.back();
-            vmaClearVirtualBlock(block.handle);
-            vmaDestroyVirtualBlock(block.handle);
-            m_virtual_blocks.pop_back();
-            LOG_ERROR("increase buf failed, pop_back block, current: %d", m_virtual_blocks.size());
-            return false;
-        }
-    }
     VVK_CHECK_BOOL_RE(vmaVirtualAllocate(block.handle, &allocCreateInfo, &allocation, &offset));
     setRef(ref, block);
     return true;
@@ -201,50 +209,91 @@ void StagingBuffer::unallocateSubRef(const StagingBufferRef& ref) {
     }
 }
 
-VkResult StagingBuffer::mapStageBuf() { return m_stage_buf.handle.MapMemory(&m_stage_raw); }
+void StagingBuffer::markDirty(VirtualBlock& block, VkDeviceSize offset, VkDeviceSize size) {
+    if (size == 0) return;
+    auto& dirty = block.dirty[m_frame];
+    // members of a ref are mostly written in order
+    if (! dirty.empty() && dirty.back().dstOffset + dirty.back().size == offset) {
+        dirty.back().size += size;
+        return;
+    }
+    dirty.push_back({ .srcOffset = offset, .dstOffset = offset, .size = size });
+}
 
 bool StagingBuffer::writeToBuf(const StagingBufferRef& ref, std::span<uint8_t> data,
                                size_t offset) {
     CHECK_REF(ref, return false);
+    auto* block = refBlock(ref);
+    if (block == nullptr) return false;
 
-    if (m_stage_raw == nullptr) {
-        mapStageBuf();
-    }
     VkDeviceSize size = std::min(ref.size - offset, data.size());
-    uint8_t*     raw  = (uint8_t*)m_stage_raw;
+    uint8_t*     raw  = block->region(m_frame);
     std::copy(data.begin(), data.begin() + size, raw + ref.offset + offset);
+    markDirty(*block, ref.offset + offset, size);
     return true;
 }
 
 bool StagingBuffer::fillBuf(const StagingBufferRef& ref, size_t offset, size_t size, uint8_t c) {
     CHECK_REF(ref, return false);
+    auto* block = refBlock(ref);
+    if (block == nullptr) return false;
 
-    if (m_stage_raw == nullptr) {
-        mapStageBuf();
-    }
     VkDeviceSize size_     = std::min(ref.size - offset, size);
-    uint8_t*     raw       = (uint8_t*)m_stage_raw;
+    uint8_t*     raw       = block->region(m_frame);
     uint8_t*     raw_begin = raw + ref.offset + offset;
     std::fill(raw_begin, raw_begin + size_, c);
+    markDirty(*block, ref.offset + offset, size_);
     return true;
 }
 
-bool StagingBuffer::recordUpload(vvk::CommandBuffer& cmd) {
-    if (! m_gpu_buf.handle) {
-        if (auto opt = CreateGpuBuffer(m_device.vma_allocator(), m_usage, m_stage_buf.req_size);
-            opt.has_value()) {
-            m_gpu_buf = std::move(opt.value());
-        } else
-            return false;
+void StagingBuffer::setFrame(uint frame) {
+    frame %= m_frames;
+    if (frame == m_frame) return;
+    std::vector<VkBufferCopy> ranges;
+    for (auto& block : m_virtual_blocks) {
+        // the region missed what the other frames wrote since it was current
+        ranges.clear();
+        for (uint i = 0; i < m_frames; i++) {
+            if (i != frame)
+                ranges.insert(ranges.end(), block.dirty[i].begin(), block.dirty[i].end());
+        }
+        MergeRanges(ranges);
+        for (const auto& r : ranges) {
+            memcpy(block.region(frame) + r.dstOffset, block.region(m_frame) + r.dstOffset, r.size);
+        }
+        block.dirty[frame].clear();
     }
-    if (m_stage_raw != nullptr) {
-        m_stage_buf.handle.UnMapMemory();
-        m_stage_raw = nullptr;
+    m_frame = frame;
+}
+
+bool StagingBuffer::recordUpload(vvk::CommandBuffer& cmd) {
+    WP_TRACE_SCOPE("staging upload");
+    std::vector<VkBufferCopy> regions;
+    for (auto& block : m_virtual_blocks) {
+        regions.clear();
+        if (! block.gpu_uploaded[m_frame]) {
+            regions.push_back({ .srcOffset = 0, .dstOffset = 0, .size = block.size });
+            block.gpu_uploaded[m_frame] = true;
+        } else {
+            // written in the other frames in flight and this one, since this buffer was uploaded
+            for (const auto& dirty : block.dirty)
+                regions.insert(regions.end(), dirty.begin(), dirty.end());
+            MergeRanges(regions);
+        }
+        // a single region is current again right away
+        if (m_frames == 1) block.dirty.front().clear();
+        if (regions.empty()) continue;
+
+        VkDeviceSize base = m_frame * block.size;
+        VVK_CHECK_BOOL_RE(vmaFlushAllocation(
+            m_device.vma_allocator(), block.stage_buf.handle.Allocation(), base, block.size));
+        for (auto& r : regions) r.srcOffset += base;
+        RecordCopyBuffer(block.gpu_bufs[m_frame], block.stage_buf, regions, cmd);
     }
-    VVK_CHECK_BOOL_RE(vmaFlushAllocation(
-        m_device.vma_allocator(), m_stage_buf.handle.Allocation(), 0, VK_WHOLE_SIZE));
-    RecordCopyBuffer(m_gpu_buf, m_stage_buf, cmd);
     return true;
 }
 
-VkBuffer StagingBuffer::gpuBuf() const { return *m_gpu_buf.handle; }
+VkBuffer StagingBuffer::gpuBuf(const StagingBufferRef& ref) const {
+    if (! ref || ref.m_virtual_index >= m_virtual_blocks.size()) return VK_NULL_HANDLE;
+    return *m_virtual_blocks[ref.m_virtual_index].gpu_bufs[m_frame].handle;
+}
@@ -10,11 +10,14 @@
 #include "Core/ArrayHelper.hpp"
 #include "Utils/AutoDeletor.hpp"
 #include "Utils/Hash.h"
+#include "Utils/Trace.h"
 #include "include/Vulkan/Parameters.hpp"
 #include "vvk/vulkan_wrapper.hpp"
 
+#include <algorithm>
 #include <cstdio>
 #include <optional>
+#include <string>
 
 using namespace wallpaper;
 using namespace wallpaper::vulkan;
@@ -57,6 +60,21 @@ VkFilter ToVkType(wallpaper::TextureFilter sam) {
 
 namespace
 {
+// streamed textures start with the levels up to this extent
+constexpr u32 STREAM_FIRST_EXTENT { 256 };
+// bytes of higher levels uploaded per frame, at least one level
+constexpr usize STREAM_BYTES_PER_FRAME { 16u * 1024u * 1024u };
+
+// first level uploaded before the texture is used, 0 if not streamed
+uint StreamFirstLevel(const Image::Slot& slot) {
+    uint levels = (uint)slot.mipmaps.size();
+    for (uint i = 0; i < levels; i++) {
+        const auto& mip = slot.mipmaps[i];
+        if ((u32)std::max(mip.width, mip.height) <= STREAM_FIRST_EXTENT) return i;
+    }
+    return levels - 1;
+}
+
 VkSamplerCreateInfo GenSamplerInfo(TextureKey key) {
     auto& sam = key.sample;
 
@@ -228,23 +246,26 @@ std::optional<ExImageParameters> CreateExImage(uint32_t width, uint32_t height,
 
 inline std::optional<VmaImageParameters>
 CreateImage(const Device& device, VkExtent3D extent, u32 miplevel, VkFormat format,
-            VkSamplerCreateInfo sampler_info, VkImageUsageFlags usage,
-            VmaMemoryUsage mem_usage = VMA_MEMORY_USAGE_GPU_ONLY) {
+            std::optional<VkSamplerCreateInfo> sampler_info, VkImageUsageFlags usage,
+            std::span<const uint32_t> shared_families = {},
+            VmaMemoryUsage            mem_usage       = VMA_MEMORY_USAGE_GPU_ONLY) {
     VmaImageParameters image;
     do {
         VkImageCreateInfo info {
-            .sType                 = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
-            .pNext                 = nullptr,
-            .imageType             = VK_IMAGE_TYPE_2D,
-            .format                = format,
-            .extent                = extent,
-            .mipLevels             = miplevel,
-            .arrayLayers           = 1,
-            .samples               = VK_SAMPLE_COUNT_1_BIT,
-            .tiling                = VK_IMAGE_TILING_OPTIMAL,
-            .usage                 = usage,
-            .sharingMode           = VK_SHARING_MODE_EXCLUSIVE,
-            .queueFamilyIndexCount = 0,
+            .sType       = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+            .pNext       = nullptr,
+            .imageType   = VK_IMAGE_TYPE_2D,
+            .format      = format,
+            .extent      = extent,
+            .mipLevels   = miplevel,
+            .arrayLayers = 1,
+            .samples     = VK_SAMPLE_COUNT_1_BIT,
+            .tiling      = VK_IMAGE_TILING_OPTIMAL,
+            .usage       = usage,
+            .sharingMode = shared_families.empty() ? VK_SHARING_MODE_EXCLUSIVE
+                                                   : VK_SHARING_MODE_CONCURRENT,
+            .queueFamilyIndexCount = (uint32_t)shared_families.size(),
+            .pQueueFamilyIndices   = shared_families.data(),
             .initialLayout         = VK_IMAGE_LAYOUT_UNDEFINED,
         };
         image.extent = info.extent;
@@ -272,7 +293,8 @@ CreateImage(const Device& device, VkExtent3D extent, u32 miplevel, VkFormat form
             };
             VVK_CHECK_ACT(break, device.handle().CreateImageView(createinfo, image.view));
         }
-        VVK_CHECK_ACT(break, device.handle().CreateSampler(sampler_info, image.sampler));
+        if (sampler_info)
+            VVK_CHECK_ACT(break, device.handle().CreateSampler(*sampler_info, image.sampler));
         return image;
     } while (false);
     /*
@@ -283,84 +305,6 @@ CreateImage(const Device& device, VkExtent3D extent, u32 miplevel, VkFormat form
     return std::nullopt;
 }
 
-inline VkResult CopyImageData(std::span<const BufferParameters> in_bufs,
-                              std::span<const VkExtent3D> in_exts, const vvk::Queue& queue,
-                              vvk::CommandBuffer& cmd, const ImageParameters& image) {
-    VkResult result;
-    do {
-        result = cmd.Begin(VkCommandBufferBeginInfo {
-            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-            .pNext = nullptr,
-            .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
-        });
-        if (result != VK_SUCCESS) break;
-
-        VkImageSubresourceRange subresourceRange {
-            .aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT,
-            .baseMipLevel   = 0,
-            .levelCount     = (uint32_t)in_bufs.size(),
-            .baseArrayLayer = 0,
-            .layerCount     = 1,
-        };
-        {
-            VkImageMemoryBarrier in_bar {
-                .sType            = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-                .pNext            = nullptr,
-                .srcAccessMask    = VK_ACCESS_MEMORY_WRITE_BIT,
-                .dstAccessMask    = VK_ACCESS_TRANSFER_WRITE_BIT,
-                .oldLayout        = VK_IMAGE_LAYOUT_UNDEFINED,
-                .newLayout        = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                .image            = image.handle,
-                .subresourceRange = subresourceRange,
-            };
-            cmd.PipelineBarrier(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-                                VK_PIPELINE_STAGE_TRANSFER_BIT,
-                                VK_DEPENDENCY_BY_REGION_BIT,
-                                in_bar);
-        }
-        VkBufferImageCopy copy {
-            .imageSubresource =
-                VkImageSubresourceLayers {
-                    .aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT,
-                    .baseArrayLayer = 0,
-                    .layerCount     = 1,
-                },
-        };
-        for (usize i = 0; i < in_bufs.size(); i++) {
-            copy.imageSubresource.mipLevel = (u32)i;
-            copy.imageExtent               = in_exts[i];
-            cmd.CopyBufferToImage(
-                in_bufs[i].handle, image.handle, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, copy);
-        }
-        {
-            VkImageMemoryBarrier out_bar {
-                .sType            = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-                .pNext            = nullptr,
-                .srcAccessMask    = VK_ACCESS_TRANSFER_WRITE_BIT,
-                .dstAccessMask    = VK_ACCESS_SHADER_READ_BIT,
-                .oldLayout        = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                .newLayout        = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-                .image            = image.handle,
-                .subresourceRange = subresourceRange,
-            };
-            cmd.PipelineBarrier(VK_PIPELINE_STAGE_TRANSFER_BIT,
-                                VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-                                VK_DEPENDENCY_BY_REGION_BIT,
-                                out_bar);
-        }
-        result = cmd.End();
-        if (result != VK_SUCCESS) break;
-
-        VkSubmitInfo sub_info {
-            .sType              = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-            .pNext              = nullptr,
-            .commandBufferCount = 1,
-            .pCommandBuffers    = cmd.address(),
-        };
-        result = queue.Submit(sub_info);
-    } while (false);
-    return result;
-}
 } // namespace
 
 std::size_t TextureKey::HashValue(const TextureKey& k) {
@@ -417,15 +361,14 @@ std::optional<ExImageParameters> TextureCache::CreateExTex(uint32_t width, uint3
     return opt;
 }
 
-ImageSlotsRef TextureCache::CreateTex(Image& image) {
+ImageSlotsRef TextureCache::CreateTex(std::shared_ptr<const Image> image_ptr) {
+    const auto& image = *image_ptr;
     if (exists(m_tex_map, image.key)) {
         return m_tex_map.at(image.key);
     }
 
     ImageSlots img_slots;
 
-    if (! m_tex_cmd) allocateCmd();
-
     img_slots.slots.resize(image.slots.size());
 
     auto& sam = image.header.sample;
@@ -437,6 +380,9 @@ ImageSlotsRef TextureCache::CreateTex(Image& image) {
 
         // check data
         if (! image_slot) return {};
+        // higher levels are streamed in later, not sampled until then
+        uint first = StreamFirstLevel(image_slot);
+
         VkSamplerCreateInfo sampler_info {
             .sType                   = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
             .pNext                   = nullptr,
@@ -450,7 +396,7 @@ ImageSlotsRef TextureCache::CreateTex(Image& image) {
             .maxAnisotropy           = (1.0f),
             .compareEnable           = (false),
             .compareOp               = VK_COMPARE_OP_NEVER,
-            .minLod                  = (0.0f),
+            .minLod                  = (float)first,
             .maxLod                  = (float)mipmap_levels,
             .borderColor             = VK_BORDER_COLOR_INT_OPAQUE_BLACK,
             .unnormalizedCoordinates = (false),
@@ -463,42 +409,302 @@ ImageSlotsRef TextureCache::CreateTex(Image& image) {
                                    (u32)mipmap_levels,
                                    format,
                                    sampler_info,
-                                   VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
+                                   VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
+                                       VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                                   m_uploader.SharedFamilies());
             opt.has_value()) {
             image_paras = std::move(opt.value());
         } else
             break;
 
-        std::vector<VmaBufferParameters> stage_bufs;
-        std::vector<VkExtent3D>          extents;
-
-        for (usize j = 0; j < image_slot.mipmaps.size(); j++) {
-            auto&               image_data = image_slot.mipmaps[j];
-            VmaBufferParameters buf;
-            (void)CreateStagingBuffer(m_device.vma_allocator(), (u32)image_data.size, buf);
-            {
-                void* v_data;
-                VVK_CHECK(buf.handle.MapMemory(&v_data));
-                memcpy(v_data, image_data.data.get(), (u32)image_data.size);
-                buf.handle.UnMapMemory();
+        std::vector<TextureUploader::MipData> mips;
+        for (usize level = first; level < mipmap_levels; level++) {
+            mips.push_back(mipData(image_slot.mipmaps[level]));
+        }
+        if (! m_uploader.InitLayout(image_paras, first) ||
+            ! m_uploader.Upload(image_paras, format, mips, image_ptr, first)) {
+            LOG_ERROR("upload tex \"%s\" failed", image.key.c_str());
+        }
+        img_slots.format = format;
+
+        auto info = slotInfo(image_paras, format);
+        if (first > 0) {
+            // shrinking would copy levels not uploaded yet
+            info.can_shrink = false;
+            m_streams.push_back(StreamTex {
+                .key          = image.key,
+                .slot         = i,
+                .image        = image_ptr,
+                .sampler_info = sampler_info,
+                .resident     = first,
+                .loading      = first,
+            });
+        }
+        m_residency.Track(image.key, i, info);
+    }
+    m_tex_map[image.key] = std::move(img_slots);
+    return m_tex_map[image.key];
+}
+
+TextureUploader::MipData TextureCache::mipData(const ImageData& image_data) {
+    TextureUploader::MipData mip {
+        .data   = image_data.data.get(),
+        .size   = (usize)image_data.size,
+        .extent = VkExtent3D { (u32)image_data.width, (u32)image_data.height, 1 },
+    };
+    // decoded into our staging memory
+    std::unique_lock lock(m_staging_mutex);
+    if (auto it = m_staging_data.find(mip.data); it != m_staging_data.end()) {
+        mip.staging = *it->second->handle;
+    }
+    return mip;
+}
+
+void TextureCache::UpdateStreaming() {
+    if (m_streams.empty()) return;
+    WP_TRACE_SCOPE("tex streaming");
+
+    usize budget { STREAM_BYTES_PER_FRAME };
+    bool  swapped { false };
+
+    std::vector<StreamTex> streams;
+    for (auto& s : m_streams) {
+        auto it = m_tex_map.find(s.key);
+        if (it == m_tex_map.end() || s.slot >= it->second.slots.size()) continue;
+        auto& slots = it->second;
+        auto& image = slots.slots[s.slot];
+
+        if (s.loading < s.resident) {
+            if (! m_uploader.Done(s.serial)) {
+                streams.push_back(std::move(s));
+                continue;
+            }
+            auto info   = s.sampler_info;
+            info.minLod = (float)s.loading;
+            vvk::Sampler sampler;
+            VVK_CHECK_ACT(continue, m_device.handle().CreateSampler(info, sampler));
+            // the frames in flight may still sample with the old one
+            m_device.Retire(std::move(image.sampler));
+            image.sampler = std::move(sampler);
+            s.resident    = s.loading;
+            swapped       = true;
+        }
+        if (s.resident == 0) {
+            // all levels in, the decoded data is released
+            m_residency.Track(s.key, s.slot, slotInfo(image, slots.format));
+            continue;
+        }
+        if (budget > 0) {
+            auto  mip  = mipData(s.image->slots[s.slot].mipmaps[s.resident - 1]);
+            usize size = mip.size;
+            if (m_uploader.Upload(image, slots.format, { &mip, 1 }, s.image, s.resident - 1)) {
+                s.loading = s.resident - 1;
+                s.serial  = m_uploader.Serial();
             }
-            stage_bufs.emplace_back(std::move(buf));
-            extents.push_back(VkExtent3D { (u32)image_data.width, (u32)image_data.height, 1 });
+            budget = size >= budget ? 0 : budget - size;
+        }
+        streams.push_back(std::move(s));
+    }
+    m_streams = std::move(streams);
+    m_uploader.Flush();
+    if (swapped) m_generation++;
+}
+
+void TextureCache::FlushUploads() { m_uploader.Flush(); }
+
+void TextureCache::WaitUploads() { m_uploader.Wait(); }
+
+const ImageSlots* TextureCache::Find(std::string_view key) const {
+    auto it = m_tex_map.find(key);
+    return it == m_tex_map.end() ? nullptr : &it->second;
+}
+
+void TextureCache::MarkUsed(std::string_view key, usize slot) { m_residency.MarkUsed(key, slot); }
+
+ResidencyManager::SlotInfo TextureCache::slotInfo(const VmaImageParameters& image,
+                                                  VkFormat                  format) const {
+    VmaAllocationInfo alloc_info {};
+    vmaGetAllocationInfo(m_device.vma_allocator(), image.handle.Allocation(), &alloc_info);
+
+    constexpr VkFormatFeatureFlags blit = VK_FORMAT_FEATURE_BLIT_SRC_BIT |
+                                          VK_FORMAT_FEATURE_BLIT_DST_BIT |
+                                          VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    auto features = m_device.gpu().GetFormatProperties(format).optimalTilingFeatures;
+    return ResidencyManager::SlotInfo {
+        .size       = (usize)alloc_info.size,
+        .width      = image.extent.width,
+        .height     = image.extent.height,
+        .levels     = image.mipmap_level,
+        .can_shrink = image.mipmap_level > 1 || (features & blit) == blit,
+    };
+}
+
+// record a copy of the image without its top levels, or downscaled if it has only one
+std::optional<VmaImageParameters> TextureCache::recShrink(vvk::CommandBuffer& cmd,
+                                                          VmaImageParameters& old, VkFormat format,
+                                                          ResidencyAction action) const {
+    const uint levels = old.mipmap_level;
+    const bool blit   = levels == 1;
+    const uint first  = blit ? 0 : (action == ResidencyAction::DROP_MIPS ? 1 : levels - 1);
+    const u32  shift  = blit ? (action == ResidencyAction::DROP_MIPS ? 1u : 2u) : first;
+
+    auto mip_ext = [](VkExtent3D ext, u32 level) {
+        return VkExtent3D { std::max(ext.width >> level, 1u), std::max(ext.height >> level, 1u), 1 };
+    };
+
+    auto opt = CreateImage(m_device,
+                           mip_ext(old.extent, shift),
+                           levels - first,
+                           format,
+                           std::nullopt,
+                           VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT |
+                               VK_IMAGE_USAGE_SAMPLED_BIT);
+    if (! opt) return std::nullopt;
+    auto& image = *opt;
+
+    VkImageMemoryBarrier bar {
+        .sType            = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .pNext            = nullptr,
+        .srcAccessMask    = VK_ACCESS_SHADER_READ_BIT,
+        .dstAccessMask    = VK_ACCESS_TRANSFER_READ_BIT,
+        .oldLayout        = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        .newLayout        = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        .image            = *old.handle,
+        .subresourceRange = VkImageSubresourceRange {
+            .aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT,
+            .baseMipLevel   = 0,
+            .levelCount     = VK_REMAINING_MIP_LEVELS,
+            .baseArrayLayer = 0,
+            .layerCount     = 1,
+        },
+    };
+    cmd.PipelineBarrier(VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, bar);
+
+    bar.srcAccessMask = 0;
+    bar.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    bar.oldLayout     = VK_IMAGE_LAYOUT_UNDEFINED;
+    bar.newLayout     = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    bar.image         = *image.handle;
+    cmd.PipelineBarrier(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, bar);
+
+    VkImageSubresourceLayers layers {
+        .aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT,
+        .mipLevel       = 0,
+        .baseArrayLayer = 0,
+        .layerCount     = 1,
+    };
+    if (blit) {
+        auto        dst_ext = image.extent;
+        VkImageBlit region {
+            .srcSubresource = layers,
+            .srcOffsets     = { VkOffset3D { 0, 0, 0 },
+                                VkOffset3D { (i32)old.extent.width, (i32)old.extent.height, 1 } },
+            .dstSubresource = layers,
+            .dstOffsets     = { VkOffset3D { 0, 0, 0 },
+                                VkOffset3D { (i32)dst_ext.width, (i32)dst_ext.height, 1 } },
+        };
+        cmd.BlitImage(*old.handle,
+                      VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                      *image.handle,
+                      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                      region,
+                      VK_FILTER_LINEAR);
+    } else {
+        std::vector<VkImageCopy> copies;
+        for (uint i = 0; i < image.mipmap_level; i++) {
+            auto& copy = copies.emplace_back(VkImageCopy {
+                .srcSubresource = layers,
+                .dstSubresource = layers,
+                .extent         = mip_ext(old.extent, first + i),
+            });
+            copy.srcSubresource.mipLevel = first + i;
+            copy.dstSubresource.mipLevel = i;
         }
+        cmd.CopyImage(*old.handle,
+                      VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                      *image.handle,
+                      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                      copies);
+    }
+
+    bar.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    bar.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    bar.oldLayout     = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    bar.newLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    cmd.PipelineBarrier(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, bar);
+    return opt;
+}
 
-        CopyImageData(transform<VmaBufferParameters>(stage_bufs,
-                                                     [](BufferParameters e) {
-                                                         return e;
-                                                     }),
-                      extents,
-                      m_device.graphics_queue().handle,
-                      m_tex_cmd,
-                      image_paras);
+void TextureCache::UpdateResidency() {
+    m_frame++;
+    vmaSetCurrentFrameIndex(m_device.vma_allocator(), (uint32_t)m_frame);
 
-        m_device.handle().WaitIdle();
+    auto budget    = m_device.GetBudget();
+    auto decisions = m_residency.Plan(m_frame, budget.usage, budget.budget);
+    if (decisions.empty()) return;
+    WP_TRACE_SCOPE("residency shrink");
+
+    struct Shrunk {
+        const ResidencyDecision* decision;
+        ImageSlots*              slots;
+        VmaImageParameters       image;
+    };
+    std::vector<Shrunk> shrunk;
+
+    if (! m_tex_cmd) allocateCmd();
+    VVK_CHECK_VOID_RE(m_tex_cmd.Begin(VkCommandBufferBeginInfo {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .pNext = nullptr,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+    }));
+    for (auto& d : decisions) {
+        auto it = m_tex_map.find(d.key);
+        if (it == m_tex_map.end() || d.slot >= it->second.slots.size()) continue;
+        auto& slots = it->second;
+        if (auto opt = recShrink(m_tex_cmd, slots.slots[d.slot], slots.format, d.action);
+            opt.has_value()) {
+            shrunk.push_back({ &d, &slots, std::move(opt.value()) });
+        }
     }
-    m_tex_map[image.key] = std::move(img_slots);
-    return m_tex_map[image.key];
+    VVK_CHECK_VOID_RE(m_tex_cmd.End());
+    {
+        VkSubmitInfo sub_info {
+            .sType              = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+            .pNext              = nullptr,
+            .commandBufferCount = 1,
+            .pCommandBuffers    = m_tex_cmd.address(),
+        };
+        VVK_CHECK_VOID_RE(m_device.graphics_queue().handle.Submit(sub_info));
+        VVK_CHECK_VOID_RE(m_device.handle().WaitIdle());
+    }
+
+    // old images are idle now
+    for (auto& s : shrunk) {
+        auto& slot      = s.slots->slots[s.decision->slot];
+        s.image.sampler = std::move(slot.sampler);
+        slot            = std::move(s.image);
+        m_residency.Applied(*s.decision, slotInfo(slot, s.slots->format));
+    }
+    if (! shrunk.empty()) m_generation++;
+}
+
+ImageDataPtr TextureCache::AllocateImageData(usize size) {
+    auto  buf    = std::make_shared<VmaBufferParameters>();
+    void* mapped = nullptr;
+    if (! CreateStagingBuffer(m_device.vma_allocator(), size, *buf) ||
+        buf->handle.MapMemory(&mapped) != VK_SUCCESS)
+        return nullptr;
+    {
+        std::unique_lock lock(m_staging_mutex);
+        m_staging_data[mapped] = buf.get();
+    }
+    return ImageDataPtr((uint8_t*)mapped, [this, buf](uint8_t* data) {
+        {
+            std::unique_lock lock(m_staging_mutex);
+            m_staging_data.erase(data);
+        }
+        buf->handle.UnMapMemory();
+    });
 }
 
 void TextureCache::allocateCmd() {
@@ -539,11 +745,21 @@ std::optional<VmaImageParameters> TextureCache::CreateTex(TextureKey tex_key) {
     return std::nullopt;
 }
 
-TextureCache::TextureCache(const Device& device): m_device(device) {}
+TextureCache::TextureCache(const Device& device): m_device(device), m_uploader(device) {}
 
 TextureCache::~TextureCache() {};
 
+void TextureCache::SetTranscode(const ImageTranscode& transcode) { m_transcode = transcode; }
+
+ImageTranscode TextureCache::Transcode() const {
+    if (! m_device.features().textureCompressionBC) return {};
+    return m_transcode;
+}
+
 void TextureCache::Clear() {
+    m_uploader.Wait();
+    m_streams.clear();
+    m_residency.Clear();
     m_tex_map.clear();
     m_query_texs.clear();
     m_query_map.clear();
@@ -584,6 +800,10 @@ std::optional<ImageParameters> TextureCache::Query(std::string_view key, Texture
     query.persist = persist;
     if (auto opt = CreateTex(content_hash); opt.has_value()) {
         query.image = std::move(opt.value());
+
+        auto info          = slotInfo(query.image, ToVkType(content_hash.format));
+        info.render_target = true;
+        m_residency.Track("rt:" + std::to_string(query.index), 0, info);
         return query.image;
     }
     return std::nullopt;
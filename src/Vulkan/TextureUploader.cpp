@@ -0,0 +1,303 @@
+#include "TextureUploader.hpp"
+#include "Device.hpp"
+#include "Util.hpp"
+
+#include "Utils/Logging.h"
+#include "Utils/Trace.h"
+
+#include <cstring>
+#include <numeric>
+
+using namespace wallpaper;
+using namespace wallpaper::vulkan;
+
+namespace
+{
+constexpr VkDeviceSize ARENA_SIZE { 32u * 1024u * 1024u };
+
+// copy offsets must be a multiple of 4 and of the texel block size
+VkDeviceSize CopyAlignment(VkFormat format) {
+    VkDeviceSize block { 4 };
+    switch (format) {
+    case VK_FORMAT_BC1_RGBA_UNORM_BLOCK: block = 8; break;
+    case VK_FORMAT_BC2_UNORM_BLOCK:
+    case VK_FORMAT_BC3_UNORM_BLOCK: block = 16; break;
+    case VK_FORMAT_R8G8B8_UNORM: block = 3; break;
+    default: break;
+    }
+    return std::lcm(block, (VkDeviceSize)16);
+}
+
+inline VkDeviceSize AlignUp(VkDeviceSize x, VkDeviceSize align) {
+    return (x + align - 1) / align * align;
+}
+} // namespace
+
+TextureUploader::TextureUploader(const Device& device): m_device(device) {}
+
+TextureUploader::~TextureUploader() {
+    if (! m_inited) return;
+    Wait();
+    m_arena.handle.UnMapMemory();
+}
+
+std::span<const uint32_t> TextureUploader::SharedFamilies() {
+    (void)init();
+    return m_shared_families;
+}
+
+bool TextureUploader::init() {
+    if (m_inited) return true;
+
+    m_queue = m_device.transfer_queue();
+    m_shared_families.clear();
+    if (m_queue.family_index != m_device.graphics_queue().family_index) {
+        m_shared_families = { m_device.graphics_queue().family_index, m_queue.family_index };
+    }
+
+    VkCommandPoolCreateInfo info { .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+                                   .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT |
+                                            VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+                                   .queueFamilyIndex = m_queue.family_index };
+    VVK_CHECK_BOOL_RE(m_device.handle().CreateCommandPool(info, m_pool));
+
+    void* mapped { nullptr };
+    if (! CreateStagingBuffer(m_device.vma_allocator(), ARENA_SIZE, m_arena)) return false;
+    VVK_CHECK_BOOL_RE(m_arena.handle.MapMemory(&mapped));
+    m_arena_mapped = (uint8_t*)mapped;
+    m_inited       = true;
+    return true;
+}
+
+TextureUploader::Batch* TextureUploader::current() {
+    if (m_recording) return m_recording.get();
+
+    std::unique_ptr<Batch> batch;
+    if (! m_free.empty()) {
+        batch = std::move(m_free.back());
+        m_free.pop_back();
+    } else {
+        batch = std::make_unique<Batch>();
+        if (m_pool.Allocate(1, VK_COMMAND_BUFFER_LEVEL_PRIMARY, batch->cmds) != VK_SUCCESS)
+            return nullptr;
+        batch->cmd = vvk::CommandBuffer(batch->cmds[0], m_device.handle().Dispatch());
+        VVK_CHECK_ACT(return nullptr,
+                      m_device.handle().CreateFence(
+                          VkFenceCreateInfo {
+                              .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+                              .pNext = nullptr,
+                              .flags = 0,
+                          },
+                          batch->fence));
+    }
+    VVK_CHECK_ACT(return nullptr,
+                  batch->cmd.Begin(VkCommandBufferBeginInfo {
+                      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+                      .pNext = nullptr,
+                      .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+                  }));
+    batch->serial = m_next_serial;
+    m_recording   = std::move(batch);
+    return m_recording.get();
+}
+
+bool TextureUploader::Upload(const ImageParameters& image, VkFormat format,
+                             std::span<const MipData> mips, std::shared_ptr<const void> keep,
+                             u32 base_level) {
+    if (! init()) return false;
+
+    VkDeviceSize align = CopyAlignment(format);
+
+    // arena space of this image, allocated in one piece so a wrap never splits it
+    VkDeviceSize need { 0 };
+    for (auto& mip : mips) {
+        if (mip.staging == VK_NULL_HANDLE) need += AlignUp(mip.size, align);
+    }
+    bool use_arena = need <= ARENA_SIZE;
+    if (use_arena && AlignUp(m_arena_head, align) + need > ARENA_SIZE) {
+        // wrap, the front is still read by submitted batches
+        Wait();
+        m_arena_head = 0;
+    }
+
+    Batch* batch = current();
+    if (batch == nullptr) return false;
+
+    std::vector<VkBufferImageCopy> copies(mips.size());
+    std::vector<VkBuffer>          srcs(mips.size());
+    for (usize i = 0; i < mips.size(); i++) {
+        auto& mip  = mips[i];
+        auto& copy = copies[i];
+        copy       = VkBufferImageCopy {
+                  .bufferOffset = 0,
+                  .imageSubresource =
+                VkImageSubresourceLayers {
+                          .aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT,
+                          .mipLevel       = base_level + (u32)i,
+                          .baseArrayLayer = 0,
+                          .layerCount     = 1,
+                },
+                  .imageExtent = mip.extent,
+        };
+
+        if (mip.staging != VK_NULL_HANDLE) {
+            srcs[i] = mip.staging;
+        } else if (use_arena) {
+            m_arena_head = AlignUp(m_arena_head, align);
+            std::memcpy(m_arena_mapped + m_arena_head, mip.data, mip.size);
+            srcs[i]           = *m_arena.handle;
+            copy.bufferOffset = m_arena_head;
+            m_arena_head += mip.size;
+        } else {
+            // larger than the arena
+            VmaBufferParameters buf;
+            void*               mapped { nullptr };
+            if (! CreateStagingBuffer(m_device.vma_allocator(), mip.size, buf)) return false;
+            VVK_CHECK_BOOL_RE(buf.handle.MapMemory(&mapped));
+            std::memcpy(mapped, mip.data, mip.size);
+            buf.handle.UnMapMemory();
+            srcs[i] = *buf.handle;
+            batch->dedicated.emplace_back(std::move(buf));
+        }
+    }
+
+    auto&                   cmd = batch->cmd;
+    VkImageSubresourceRange subresourceRange {
+        .aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT,
+        .baseMipLevel   = base_level,
+        .levelCount     = (uint32_t)mips.size(),
+        .baseArrayLayer = 0,
+        .layerCount     = 1,
+    };
+    {
+        VkImageMemoryBarrier in_bar {
+            .sType            = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .pNext            = nullptr,
+            .srcAccessMask    = 0,
+            .dstAccessMask    = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .oldLayout        = VK_IMAGE_LAYOUT_UNDEFINED,
+            .newLayout        = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            .image            = image.handle,
+            .subresourceRange = subresourceRange,
+        };
+        cmd.PipelineBarrier(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                            VK_PIPELINE_STAGE_TRANSFER_BIT,
+                            VK_DEPENDENCY_BY_REGION_BIT,
+                            in_bar);
+    }
+    for (usize i = 0; i < mips.size(); i++) {
+        cmd.CopyBufferToImage(srcs[i], image.handle, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, copies[i]);
+    }
+    {
+        // the fence wait before first use orders the copies for the graphics queue
+        // transfer queues can't name the fragment stage
+        VkImageMemoryBarrier out_bar {
+            .sType            = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .pNext            = nullptr,
+            .srcAccessMask    = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .dstAccessMask    = 0,
+            .oldLayout        = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            .newLayout        = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            .image            = image.handle,
+            .subresourceRange = subresourceRange,
+        };
+        cmd.PipelineBarrier(VK_PIPELINE_STAGE_TRANSFER_BIT,
+                            VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                            VK_DEPENDENCY_BY_REGION_BIT,
+                            out_bar);
+    }
+    batch->keep.emplace_back(std::move(keep));
+    return true;
+}
+
+bool TextureUploader::InitLayout(const ImageParameters& image, u32 level_count) {
+    if (level_count == 0) return true;
+    if (! init()) return false;
+    Batch* batch = current();
+    if (batch == nullptr) return false;
+
+    VkImageMemoryBarrier bar {
+        .sType            = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .pNext            = nullptr,
+        .srcAccessMask    = 0,
+        .dstAccessMask    = 0,
+        .oldLayout        = VK_IMAGE_LAYOUT_UNDEFINED,
+        .newLayout        = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        .image            = image.handle,
+        .subresourceRange = VkImageSubresourceRange {
+            .aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT,
+            .baseMipLevel   = 0,
+            .levelCount     = level_count,
+            .baseArrayLayer = 0,
+            .layerCount     = 1,
+        },
+    };
+    batch->cmd.PipelineBarrier(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                               VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                               VK_DEPENDENCY_BY_REGION_BIT,
+                               bar);
+    return true;
+}
+
+void TextureUploader::Flush() {
+    collect();
+    if (! m_recording) return;
+    WP_TRACE_SCOPE("tex upload submit");
+
+    auto batch = std::move(m_recording);
+    VVK_CHECK_ACT(return, batch->cmd.End());
+
+    VkSubmitInfo sub_info {
+        .sType              = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .pNext              = nullptr,
+        .commandBufferCount = 1,
+        .pCommandBuffers    = batch->cmd.address(),
+    };
+    VVK_CHECK_ACT(return, m_queue.handle.Submit(sub_info, *batch->fence));
+    m_submitted = batch->serial;
+    m_next_serial++;
+    m_inflight.push_back(std::move(batch));
+}
+
+void TextureUploader::Wait() {
+    Flush();
+    if (m_inflight.empty()) return;
+    WP_TRACE_SCOPE("tex upload wait");
+    for (auto& batch : m_inflight) {
+        VVK_CHECK(batch->fence.Wait());
+        release(*batch);
+        m_free.push_back(std::move(batch));
+    }
+    m_inflight.clear();
+}
+
+u64 TextureUploader::Serial() const { return m_recording ? m_recording->serial : m_next_serial; }
+
+bool TextureUploader::Done(u64 serial) {
+    if (serial > m_submitted) return false;
+    collect();
+    for (auto& batch : m_inflight) {
+        if (batch->serial == serial) return false;
+    }
+    return true;
+}
+
+void TextureUploader::collect() {
+    std::vector<std::unique_ptr<Batch>> pending;
+    for (auto& batch : m_inflight) {
+        if (batch->fence.GetStatus() == VK_SUCCESS) {
+            release(*batch);
+            m_free.push_back(std::move(batch));
+        } else {
+            pending.push_back(std::move(batch));
+        }
+    }
+    m_inflight = std::move(pending);
+}
+
+void TextureUploader::release(Batch& batch) {
+    // the command buffer is reset by the next Begin
+    (void)batch.fence.Reset();
+    batch.keep.clear();
+    batch.dedicated.clear();
+}
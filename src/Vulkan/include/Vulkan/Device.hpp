@@ -1,4 +1,7 @@
 #pragma once
+#include <memory>
+#include <mutex>
+
 #include "Instance.hpp"
 #include "Swapchain.hpp"
 #include "vk_mem_alloc.h"
@@ -7,6 +10,10 @@
 
 namespace wallpaper
 {
+namespace fs
+{
+class VFS;
+}
 namespace vulkan
 {
 
@@ -24,10 +31,14 @@ public:
 
     const auto& graphics_queue() const { return m_graphics_queue; }
     const auto& present_queue() const { return m_present_queue; }
+    // transfer-only queue if the device has one, otherwise the graphics queue
+    const auto& transfer_queue() const { return m_transfer_queue; }
     const auto& device() const { return m_device; }
     const auto& handle() const { return m_device; }
     const auto& gpu() const { return m_gpu; }
     const auto& limits() const { return m_limits; }
+    // enabled features
+    const auto& features() const { return m_features; }
     const auto& vma_allocator() const { return *m_allocator; }
     const auto& cmd_pool() const { return m_command_pool; }
     const auto& swapchain() const { return m_swapchain; }
@@ -38,30 +49,70 @@ public:
 
     TextureCache& tex_cache() const { return *m_tex_cache; }
 
+    // used by all pipeline creation of this device
+    const auto& pipeline_cache() const { return m_pipeline_cache; }
+    // merges the cache saved by earlier runs or other scenes, if from the same driver and gpu
+    void LoadPipelineCache(fs::VFS&);
+    // written to /cache if pipelines were added since the last load or save
+    // merged with the saved cache first, for pipelines other scenes added since
+    void SavePipelineCache(fs::VFS&);
+
+    // objects the frames in flight may still use, destroyed once the current frame retires
+    // thread safe
+    template<typename T>
+    void Retire(T&& v) const {
+        retire(std::make_shared<std::decay_t<T>>(std::forward<T>(v)));
+    }
+    // frame being recorded, frames before completed are done on the gpu
+    void SetFrame(u64 recording, u64 completed);
+
     VkDeviceSize GetUsage() const;
 
+    struct MemoryBudget {
+        VkDeviceSize usage { 0 };
+        VkDeviceSize budget { 0 };
+    };
+    // of the device local heaps, from VK_EXT_memory_budget if supported
+    MemoryBudget GetBudget() const;
+
 private:
     std::vector<VkDeviceQueueCreateInfo> ChooseDeviceQueue(VkSurfaceKHR = {});
+    void                                 retire(std::shared_ptr<void>) const;
+    // merges the cache file into m_pipeline_cache, false if missing or not usable
+    bool mergeSavedPipelineCache(fs::VFS&);
 
     vvk::DeviceDispatch     dld;
     vvk::Device             m_device;
     vvk::PhysicalDevice     m_gpu;
     vvk::VmaAllocatorHandle m_allocator;
 
-    VkPhysicalDeviceLimits m_limits;
-    Set<std::string>       m_extensions;
+    VkPhysicalDeviceLimits   m_limits;
+    VkPhysicalDeviceFeatures m_features {};
+    Set<std::string>         m_extensions;
 
     Swapchain m_swapchain;
 
-    vvk::CommandPool m_command_pool;
+    vvk::CommandPool   m_command_pool;
+    vvk::PipelineCache m_pipeline_cache;
+    // data size when last loaded or saved
+    usize m_pipeline_cache_size { 0 };
 
     QueueParameters m_graphics_queue;
     QueueParameters m_present_queue;
+    QueueParameters m_transfer_queue;
 
     // output extent
     VkExtent2D m_extent { 1, 1 };
 
     std::unique_ptr<TextureCache> m_tex_cache;
+
+    struct Retired {
+        u64                   frame;
+        std::shared_ptr<void> object;
+    };
+    mutable std::mutex           m_retire_mutex;
+    mutable std::vector<Retired> m_retired;
+    u64                          m_frame { 0 };
 };
 
 } // namespace vulkan
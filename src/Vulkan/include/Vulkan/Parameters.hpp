@@ -90,6 +90,7 @@ struct ImageParameters {
 
 struct ImageSlots : NoCopy {
     std::vector<VmaImageParameters> slots;
+    VkFormat                        format { VK_FORMAT_UNDEFINED };
 
     ImageSlots();
     ~ImageSlots();
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <deque>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Core/Literals.hpp"
+#include "Core/MapSet.hpp"
+#include "Core/NoCopyMove.hpp"
+
+namespace wallpaper
+{
+namespace vulkan
+{
+
+enum class ResidencyAction
+{
+    // drop the top mip level (halve the size) of a rarely sampled large texture
+    DROP_MIPS,
+    // shrink a sprite slot not shown for a long time to its smallest level
+    EVICT_SLOT
+};
+
+struct ResidencyDecision {
+    ResidencyAction action;
+    std::string     key;
+    usize           slot { 0 };
+    u64             frame { 0 };
+    usize           freed { 0 };
+};
+
+// tracks texture and render target memory, picks what to shrink when over the vram budget
+// only the policy, TextureCache applies the decisions
+class ResidencyManager : NoCopy, NoMove {
+public:
+    struct SlotInfo {
+        usize size { 0 };
+        u32   width { 0 };
+        u32   height { 0 };
+        uint  levels { 1 };
+        bool  render_target { false };
+        // false if the image can't be made smaller, eg. single level compressed
+        bool  can_shrink { true };
+        bool  evicted { false };
+        u64   tracked { 0 };
+        u64   last_used { 0 };
+        u64   uses { 0 };
+    };
+
+    ResidencyManager();
+    ~ResidencyManager();
+
+    // bytes, 0 uses the driver budget only
+    void  SetBudget(usize);
+    usize Budget() const { return m_budget; }
+
+    void Track(std::string_view key, usize slot, const SlotInfo&);
+    void Clear();
+
+    // called for every texture slot sampled in a frame
+    void MarkUsed(std::string_view key, usize slot);
+
+    // decisions to get back under budget, empty if under
+    // usage and budget of the device local heaps
+    std::vector<ResidencyDecision> Plan(u64 frame, usize usage, usize budget);
+    // a planned decision was applied, the slot now has this size
+    void Applied(const ResidencyDecision&, const SlotInfo&);
+
+    const SlotInfo* Find(std::string_view key, usize slot) const;
+
+    usize TextureBytes() const;
+    usize RenderTargetBytes() const;
+
+    // recently applied decisions, oldest first
+    const std::deque<ResidencyDecision>& Decisions() const { return m_decisions; }
+    void SetDecisionCallback(std::function<void(const ResidencyDecision&)>);
+
+private:
+    StringHashMap<std::vector<SlotInfo>> m_slots;
+
+    usize m_budget { 0 };
+    u64   m_frame { 0 };
+    u64   m_next_plan { 0 };
+
+    std::deque<ResidencyDecision>                  m_decisions;
+    std::function<void(const ResidencyDecision&)> m_callback;
+};
+
+} // namespace vulkan
+} // namespace wallpaper
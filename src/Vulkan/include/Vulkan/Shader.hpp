@@ -37,5 +37,11 @@ struct ShaderReflected {
 
 bool GenReflect(std::span<const std::vector<uint>> codes, std::vector<Uni_ShaderSpv>& spvs,
                 ShaderReflected& ref);
+
+// compact form of the reflection and the stages of spvs, cached next to the spirv
+std::vector<uint8_t> SaveReflect(std::span<const Uni_ShaderSpv> spvs, const ShaderReflected&);
+// same result as GenReflect without running spirv-reflect, false if data doesn't match codes
+bool LoadReflect(std::span<const uint8_t> data, std::span<const std::vector<uint>> codes,
+                 std::vector<Uni_ShaderSpv>& spvs, ShaderReflected& ref);
 } // namespace vulkan
 } // namespace wallpaper
@@ -12,6 +12,7 @@ namespace vulkan
 class Device;
 class StagingBuffer;
 
+// offset in the block of the ref
 class StagingBufferRef {
 public:
     VkDeviceSize size { 0 };
@@ -25,9 +26,15 @@ private:
     size_t               m_virtual_index { 0 };
 };
 
+// refs are suballocated from blocks, each with its own host and gpu buffers
+// a full buffer adds a block, existing refs and their content stay where they are
+// empty blocks are kept and reused for later refs
+// with frames > 1, each frame in flight has its own host region and gpu buffer in a block
+// refs have the same offset in all regions
+// only bytes written since a gpu buffer was last uploaded are copied to it
 class StagingBuffer : NoCopy, NoMove {
 public:
-    StagingBuffer(const Device&, VkDeviceSize size, VkBufferUsageFlags);
+    StagingBuffer(const Device&, VkDeviceSize size, VkBufferUsageFlags, uint frames = 1);
     ~StagingBuffer();
 
     bool allocate();
@@ -38,33 +45,49 @@ public:
     bool writeToBuf(const StagingBufferRef&, std::span<uint8_t>, size_t offset = 0);
     bool fillBuf(const StagingBufferRef& ref, size_t offset, size_t size, uint8_t c);
 
+    // frame in flight written and uploaded next, once its last upload is done
+    // the region starts with the content of the previous frame
+    void setFrame(uint frame);
+    // after the writes of the frame, nothing is recorded if nothing changed
     bool recordUpload(vvk::CommandBuffer&);
 
-    VkBuffer gpuBuf() const;
+    // block buffer of the ref, for the current frame
+    VkBuffer gpuBuf(const StagingBufferRef&) const;
 
 private:
     struct VirtualBlock {
         VmaVirtualBlock handle {};
         bool            enabled { false };
         size_t          index { 0 };
-        VkDeviceSize    offset { 0 };
-        VkDeviceSize    size { 0 };
+        // of each frame region
+        VkDeviceSize size { 0 };
+
+        // mapped, a region for each frame
+        VmaBufferParameters              stage_buf;
+        uint8_t*                         stage_raw { nullptr };
+        std::vector<VmaBufferParameters> gpu_bufs;
+        // gpu buffer has all written bytes, a new one is uploaded whole
+        std::vector<bool> gpu_uploaded;
+        // ranges written while each frame was current, offsets in the region
+        std::vector<std::vector<VkBufferCopy>> dirty;
+
+        uint8_t* region(uint frame) const { return stage_raw + frame * size; }
     };
 
-    VkResult      mapStageBuf();
+    void          markDirty(VirtualBlock&, VkDeviceSize offset, VkDeviceSize size);
+    bool          createBlockBuffers(VirtualBlock&);
     VirtualBlock* newVirtualBlock(VkDeviceSize);
-    bool          increaseBuf(VkDeviceSize);
+    VirtualBlock* refBlock(const StagingBufferRef&);
 
     const Device& m_device;
     VkDeviceSize  m_size_step;
 
     VkBufferUsageFlags m_usage;
 
-    void*                     m_stage_raw { nullptr };
-    std::vector<VirtualBlock> m_virtual_blocks {};
+    uint m_frames;
+    uint m_frame { 0 };
 
-    VmaBufferParameters m_stage_buf;
-    VmaBufferParameters m_gpu_buf;
+    std::vector<VirtualBlock> m_virtual_blocks {};
 };
 
 } // namespace vulkan
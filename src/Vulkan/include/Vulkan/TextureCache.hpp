@@ -1,15 +1,20 @@
 #pragma once
 
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
 #include "Parameters.hpp"
 #include "Type.hpp"
+#include "Image.hpp"
+#include "TextureUploader.hpp"
+#include "ResidencyManager.hpp"
 #include "Core/NoCopyMove.hpp"
 #include "Core/MapSet.hpp"
 
 namespace wallpaper
 {
 
-class Image;
-
 namespace vulkan
 {
 
@@ -36,16 +41,44 @@ struct TextureKey {
     static TexHash HashValue(const TextureKey&);
 };
 
-class TextureCache : NoCopy, NoMove {
+class TextureCache : public IImageDataAllocator, NoCopy, NoMove {
 public:
     TextureCache(const Device&);
     ~TextureCache();
 
+    // mapped staging buffer, used directly by CreateTex without a copy
+    // thread safe
+    ImageDataPtr AllocateImageData(usize size) override;
+
     void Clear();
 
     std::optional<ExImageParameters> CreateExTex(uint32_t witdh, uint32_t height, VkFormat,
                                                  VkImageTiling);
-    ImageSlotsRef                    CreateTex(Image&);
+    // upload is recorded, the image is kept until the upload is done
+    // FlushUploads/WaitUploads before the texture is sampled
+    ImageSlotsRef CreateTex(std::shared_ptr<const Image>);
+
+    void FlushUploads();
+    void WaitUploads();
+
+    const ImageSlots* Find(std::string_view key) const;
+
+    // once per frame, uploads higher levels of streamed textures
+    // textures start with their small levels, and get sharper over the next frames
+    void UpdateStreaming();
+    // once per frame, shrinks textures if over the vram budget
+    void UpdateResidency();
+    // texture slot sampled this frame
+    void MarkUsed(std::string_view key, usize slot);
+    // changed when textures or samplers were replaced, refs from CreateTex need a new lookup
+    u64 Generation() const { return m_generation; }
+
+    // rgba8 textures are block compressed while decoding, if the device supports bc
+    void           SetTranscode(const ImageTranscode&);
+    ImageTranscode Transcode() const;
+
+    ResidencyManager&       residency() { return m_residency; }
+    const ResidencyManager& residency() const { return m_residency; }
 
     std::optional<ImageParameters> Query(std::string_view key, TextureKey content_hash,
                                          bool persist = false);
@@ -56,12 +89,35 @@ public:
 
 private:
     std::optional<VmaImageParameters> CreateTex(TextureKey);
+    ResidencyManager::SlotInfo        slotInfo(const VmaImageParameters&, VkFormat) const;
+    std::optional<VmaImageParameters> recShrink(vvk::CommandBuffer&, VmaImageParameters&, VkFormat,
+                                                ResidencyAction) const;
+    TextureUploader::MipData          mipData(const ImageData&);
     void                              allocateCmd();
     vvk::CommandBuffers               m_tex_cmds;
     vvk::CommandBuffer                m_tex_cmd;
 
     const Device&                m_device;
     Map<std::string, ImageSlots> m_tex_map;
+    TextureUploader              m_uploader;
+    ResidencyManager             m_residency;
+    u64                          m_frame { 0 };
+    u64                          m_generation { 0 };
+    ImageTranscode               m_transcode;
+
+    // texture slot with levels still to upload
+    struct StreamTex {
+        std::string                  key;
+        usize                        slot { 0 };
+        std::shared_ptr<const Image> image;
+        VkSamplerCreateInfo          sampler_info;
+        // lowest level sampled, by clamping minLod
+        uint resident { 0 };
+        // level being uploaded, resident once the upload serial is done
+        uint loading { 0 };
+        u64  serial { 0 };
+    };
+    std::vector<StreamTex> m_streams;
 
     struct QueryTex {
         idx                index { 0 };
@@ -73,6 +129,10 @@ private:
     };
     std::vector<std::unique_ptr<QueryTex>> m_query_texs;
     Map<std::string, QueryTex*>            m_query_map;
+
+    // mapped address -> staging buffer, of live AllocateImageData results
+    std::mutex                                            m_staging_mutex;
+    std::unordered_map<const void*, VmaBufferParameters*> m_staging_data;
 };
 
 } // namespace vulkan
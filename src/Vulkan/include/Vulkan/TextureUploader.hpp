@@ -0,0 +1,94 @@
+#pragma once
+
+#include <memory>
+#include <span>
+#include <vector>
+
+#include "Parameters.hpp"
+#include "Core/NoCopyMove.hpp"
+#include "Core/Literals.hpp"
+
+namespace wallpaper
+{
+namespace vulkan
+{
+
+class Device;
+
+// batched texture uploads
+// copies of many textures are recorded into one command buffer, submitted once with a fence
+// source data is copied to a ring staging arena, unless already in a staging buffer
+// runs on the transfer-only queue family if the device has one
+// not thread safe, used by the render thread
+class TextureUploader : NoCopy, NoMove {
+public:
+    struct MipData {
+        const uint8_t* data { nullptr };
+        usize          size { 0 };
+        VkExtent3D     extent;
+        // set if data is the mapped memory of this buffer, copied from directly
+        VkBuffer staging { VK_NULL_HANDLE };
+    };
+
+    TextureUploader(const Device&);
+    ~TextureUploader();
+
+    // record the upload of mips to levels from base_level, they end in SHADER_READ_ONLY layout
+    // keep is released when the batch is done
+    bool Upload(const ImageParameters&, VkFormat, std::span<const MipData>,
+                std::shared_ptr<const void> keep, u32 base_level = 0);
+    // levels without data yet to SHADER_READ_ONLY, so the whole view has a valid layout
+    bool InitLayout(const ImageParameters&, u32 level_count);
+
+    // submit the recorded batch, not blocking
+    void Flush();
+    // flush and wait all submitted batches
+    void Wait();
+
+    // serial of the batch being recorded
+    u64 Serial() const;
+    // true if the batch of this serial is done
+    bool Done(u64 serial);
+
+    // queue families sampled images must be concurrent with, empty if exclusive is fine
+    std::span<const uint32_t> SharedFamilies();
+
+private:
+    struct Batch {
+        vvk::CommandBuffers cmds;
+        vvk::CommandBuffer  cmd;
+        vvk::Fence          fence;
+        u64                 serial { 0 };
+
+        std::vector<std::shared_ptr<const void>> keep;
+        std::vector<VmaBufferParameters>         dedicated;
+    };
+
+    bool   init();
+    Batch* current();
+    void   release(Batch&);
+    // reclaim finished batches
+    void collect();
+
+    const Device& m_device;
+    bool          m_inited { false };
+
+    QueueParameters       m_queue;
+    std::vector<uint32_t> m_shared_families;
+
+    vvk::CommandPool m_pool;
+
+    VmaBufferParameters m_arena;
+    uint8_t*            m_arena_mapped { nullptr };
+    VkDeviceSize        m_arena_head { 0 };
+
+    u64 m_next_serial { 1 };
+    u64 m_submitted { 0 };
+
+    std::unique_ptr<Batch>              m_recording;
+    std::vector<std::unique_ptr<Batch>> m_inflight;
+    std::vector<std::unique_ptr<Batch>> m_free;
+};
+
+} // namespace vulkan
+} // namespace wallpaper
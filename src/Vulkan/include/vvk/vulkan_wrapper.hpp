@@ -136,6 +136,7 @@ struct DeviceDispatch : InstanceDispatch {
     PFN_vkCreateGraphicsPipelines             vkCreateGraphicsPipelines {};
     PFN_vkCreateImage                         vkCreateImage {};
     PFN_vkCreateImageView                     vkCreateImageView {};
+    PFN_vkCreatePipelineCache                 vkCreatePipelineCache {};
     PFN_vkCreatePipelineLayout                vkCreatePipelineLayout {};
     PFN_vkCreateQueryPool                     vkCreateQueryPool {};
     PFN_vkCreateRenderPass                    vkCreateRenderPass {};
@@ -155,6 +156,7 @@ struct DeviceDispatch : InstanceDispatch {
     PFN_vkDestroyImage                        vkDestroyImage {};
     PFN_vkDestroyImageView                    vkDestroyImageView {};
     PFN_vkDestroyPipeline                     vkDestroyPipeline {};
+    PFN_vkDestroyPipelineCache                vkDestroyPipelineCache {};
     PFN_vkDestroyPipelineLayout               vkDestroyPipelineLayout {};
     PFN_vkDestroyQueryPool                    vkDestroyQueryPool {};
     PFN_vkDestroyRenderPass                   vkDestroyRenderPass {};
@@ -173,11 +175,13 @@ struct DeviceDispatch : InstanceDispatch {
     PFN_vkGetFenceStatus                      vkGetFenceStatus {};
     PFN_vkGetImageMemoryRequirements          vkGetImageMemoryRequirements {};
     PFN_vkGetMemoryFdKHR                      vkGetMemoryFdKHR {};
+    PFN_vkGetPipelineCacheData                vkGetPipelineCacheData {};
     PFN_vkGetPipelineExecutablePropertiesKHR  vkGetPipelineExecutablePropertiesKHR {};
     PFN_vkGetPipelineExecutableStatisticsKHR  vkGetPipelineExecutableStatisticsKHR {};
     PFN_vkGetQueryPoolResults                 vkGetQueryPoolResults {};
     PFN_vkGetSemaphoreCounterValueKHR         vkGetSemaphoreCounterValueKHR {};
     PFN_vkMapMemory                           vkMapMemory {};
+    PFN_vkMergePipelineCaches                 vkMergePipelineCaches {};
     PFN_vkQueueSubmit                         vkQueueSubmit {};
     PFN_vkResetFences                         vkResetFences {};
     PFN_vkUnmapMemory                         vkUnmapMemory {};
@@ -288,6 +292,7 @@ void Destroy(VkInstance, VkSurfaceKHR, const InstanceDispatch&) noexcept;
 void Destroy(VkDevice, VkCommandPool, const DeviceDispatch&) noexcept;
 void Destroy(VkDevice, VkPipeline, const DeviceDispatch&) noexcept;
 void Destroy(VkDevice, VkPipelineLayout, const DeviceDispatch&) noexcept;
+void Destroy(VkDevice, VkPipelineCache, const DeviceDispatch&) noexcept;
 void Destroy(VkDevice, VkRenderPass, const DeviceDispatch&) noexcept;
 void Destroy(VkDevice, VkDescriptorSetLayout, const DeviceDispatch&) noexcept;
 void Destroy(VkDevice, VkImage, const DeviceDispatch&) noexcept;
@@ -426,6 +431,24 @@ class Framebuffer : public Handle<VkFramebuffer, VkDevice, DeviceDispatch> {
 public:
 };
 
+class PipelineCache : public Handle<VkPipelineCache, VkDevice, DeviceDispatch> {
+    using Handle<VkPipelineCache, VkDevice, DeviceDispatch>::Handle;
+
+public:
+    VkResult GetData(std::vector<uint8_t>& data) const {
+        std::size_t size { 0 };
+        if (auto res = dld->vkGetPipelineCacheData(owner, handle, &size, nullptr);
+            res != VK_SUCCESS)
+            return res;
+        data.resize(size);
+        return dld->vkGetPipelineCacheData(owner, handle, &size, data.data());
+    }
+
+    VkResult Merge(Span<VkPipelineCache> srcs) const noexcept {
+        return dld->vkMergePipelineCaches(owner, handle, srcs.size(), srcs.data());
+    }
+};
+
 class ShaderModule : public Handle<VkShaderModule, VkDevice, DeviceDispatch> {
     using Handle<VkShaderModule, VkDevice, DeviceDispatch>::Handle;
 
@@ -485,8 +508,11 @@ public:
     VkResult CreateCommandPool(const VkCommandPoolCreateInfo& ci, CommandPool&) const;
     VkResult CreateDescriptorSetLayout(const VkDescriptorSetLayoutCreateInfo& ci,
                                        DescriptorSetLayout&) const noexcept;
-    VkResult CreateGraphicsPipeline(const VkGraphicsPipelineCreateInfo& ci,
-                                    Pipeline&) const noexcept;
+    VkResult CreateGraphicsPipeline(const VkGraphicsPipelineCreateInfo& ci, Pipeline&,
+                                    VkPipelineCache cache = VK_NULL_HANDLE) const noexcept;
+
+    VkResult CreatePipelineCache(const VkPipelineCacheCreateInfo& ci,
+                                 PipelineCache&) const noexcept;
 
     VkResult CreateRenderPass(const VkRenderPassCreateInfo& ci, RenderPass&) const noexcept;
 
@@ -117,6 +117,7 @@ bool Load(VkDevice device, DeviceDispatch& dld) noexcept {
     X(vkCreateGraphicsPipelines);
     X(vkCreateImage);
     X(vkCreateImageView);
+    X(vkCreatePipelineCache);
     X(vkCreatePipelineLayout);
     X(vkCreateQueryPool);
     X(vkCreateRenderPass);
@@ -136,6 +137,7 @@ bool Load(VkDevice device, DeviceDispatch& dld) noexcept {
     X(vkDestroyImage);
     X(vkDestroyImageView);
     X(vkDestroyPipeline);
+    X(vkDestroyPipelineCache);
     X(vkDestroyPipelineLayout);
     X(vkDestroyQueryPool);
     X(vkDestroyRenderPass);
@@ -155,10 +157,12 @@ bool Load(VkDevice device, DeviceDispatch& dld) noexcept {
     X(vkGetImageMemoryRequirements);
     X(vkGetMemoryFdKHR);
     X(vkGetQueryPoolResults);
+    X(vkGetPipelineCacheData);
     X(vkGetPipelineExecutablePropertiesKHR);
     X(vkGetPipelineExecutableStatisticsKHR);
     X(vkGetSemaphoreCounterValueKHR);
     X(vkMapMemory);
+    X(vkMergePipelineCaches);
     X(vkQueueSubmit);
     X(vkResetFences);
     X(vkSetDebugUtilsObjectNameEXT);
@@ -194,6 +198,9 @@ void Destroy(VkDevice device, VkPipeline handle, const DeviceDispatch& dld) noex
 void Destroy(VkDevice device, VkPipelineLayout handle, const DeviceDispatch& dld) noexcept {
     dld.vkDestroyPipelineLayout(device, handle, nullptr);
 }
+void Destroy(VkDevice device, VkPipelineCache handle, const DeviceDispatch& dld) noexcept {
+    dld.vkDestroyPipelineCache(device, handle, nullptr);
+}
 
 void Destroy(VkDevice device, VkRenderPass handle, const DeviceDispatch& dld) noexcept {
     dld.vkDestroyRenderPass(device, handle, nullptr);
@@ -430,14 +437,22 @@ VkResult Device::CreateSampler(const VkSamplerCreateInfo& ci, Sampler& sam) cons
     return res;
 }
 
-VkResult Device::CreateGraphicsPipeline(const VkGraphicsPipelineCreateInfo& ci,
-                                        Pipeline& pipeline) const noexcept {
+VkResult Device::CreateGraphicsPipeline(const VkGraphicsPipelineCreateInfo& ci, Pipeline& pipeline,
+                                        VkPipelineCache cache) const noexcept {
     VkPipeline object;
-    VkResult res = dld->vkCreateGraphicsPipelines(handle, VK_NULL_HANDLE, 1, &ci, nullptr, &object);
+    VkResult   res = dld->vkCreateGraphicsPipelines(handle, cache, 1, &ci, nullptr, &object);
     if (res == VK_SUCCESS) pipeline = Pipeline(object, handle, *dld);
     return res;
 }
 
+VkResult Device::CreatePipelineCache(const VkPipelineCacheCreateInfo& ci,
+                                     PipelineCache&                   cache) const noexcept {
+    VkPipelineCache object;
+    VkResult        res = dld->vkCreatePipelineCache(handle, &ci, nullptr, &object);
+    if (res == VK_SUCCESS) cache = PipelineCache(object, handle, *dld);
+    return res;
+}
+
 VkResult Buffer::BindMemory(VkDeviceMemory memory, VkDeviceSize offset) const noexcept {
     return dld->vkBindBufferMemory(owner, handle, memory, offset);
 }
@@ -6,6 +6,7 @@
 #include "Vulkan/Shader.hpp"
 #include "Utils/Logging.h"
 #include "Utils/AutoDeletor.hpp"
+#include "Utils/ThreadPool.hpp"
 #include "Resource.hpp"
 #include "PassCommon.hpp"
 #include "Interface/IImageParser.h"
@@ -13,6 +14,7 @@
 #include "Core/ArrayHelper.hpp"
 
 #include <cassert>
+#include <cstring>
 
 using namespace wallpaper::vulkan;
 
@@ -22,7 +24,9 @@ CustomShaderPass::CustomShaderPass(const Desc& desc) {
     m_desc.output      = desc.output;
     m_desc.sprites_map = desc.sprites_map;
 };
-CustomShaderPass::~CustomShaderPass() {}
+CustomShaderPass::~CustomShaderPass() {
+    if (m_prepare_job.valid()) utils::ThreadPool::Global().Wait(m_prepare_job);
+}
 
 std::optional<vvk::RenderPass> CreateRenderPass(const vvk::Device& device, VkFormat format,
                                                 VkAttachmentLoadOp loadOp,
@@ -80,29 +84,44 @@ std::optional<vvk::RenderPass> CreateRenderPass(const vvk::Device& device, VkFor
     }
 }
 
-static void UpdateUniform(StagingBuffer* buf, const StagingBufferRef& bufref,
-                          const ShaderReflected::Block& block, std::string_view name,
-                          const wallpaper::ShaderValue& value) {
+// the ubo keeps its content over the frames in flight, a value is written only when it changed
+static void WriteUniform(StagingBuffer* buf, const StagingBufferRef& bufref,
+                         std::vector<uint8_t>& values, size_t offset,
+                         const wallpaper::ShaderValue& value) {
     using namespace wallpaper;
-    std::span<uint8_t> value_u8 { (uint8_t*)value.data(),
-                                  value.size() * sizeof(ShaderValue::value_type) };
-    auto               uni = block.member_map.find(name);
+    if (offset >= values.size()) return;
+    size_t size = std::min(value.size() * sizeof(ShaderValue::value_type), values.size() - offset);
+    if (std::memcmp(values.data() + offset, value.data(), size) == 0) return;
+    std::memcpy(values.data() + offset, value.data(), size);
+    buf->writeToBuf(bufref, { values.data() + offset, size }, offset);
+}
+
+static void UpdateUniform(StagingBuffer* buf, const StagingBufferRef& bufref,
+                          std::vector<uint8_t>& values, const ShaderReflected::Block& block,
+                          std::string_view name, const wallpaper::ShaderValue& value) {
+    auto uni = block.member_map.find(name);
     if (uni == block.member_map.end()) {
         // log
         return;
     }
-
-    size_t offset    = uni->second.offset;
-    size_t type_size = sizeof(float) * uni->second.num;
-    if (type_size != value_u8.size()) {
-        // assert(type_size == value_u8.size());
-        ; // to do
-    }
-    buf->writeToBuf(bufref, value_u8, offset);
+    WriteUniform(buf, bufref, values, uni->second.offset, value);
 }
 
 void CustomShaderPass::prepare(Scene& scene, const Device& device, RenderingResources& rr) {
+    if (preparing()) return;
     m_desc.vk_textures.resize(m_desc.textures.size());
+
+    // decode all textures of the pass in parallel, uploads are batched by the texture cache
+    // decoded straight into staging memory of the texture cache
+    scene.imageParser->SetDataAllocator(&device.tex_cache());
+    scene.imageParser->SetTranscode(device.tex_cache().Transcode());
+    std::vector<std::shared_future<std::shared_ptr<Image>>> images(m_desc.textures.size());
+    for (usize i = 0; i < m_desc.textures.size(); i++) {
+        auto& tex_name = m_desc.textures[i];
+        if (tex_name.empty() || IsSpecTex(tex_name)) continue;
+        images[i] = scene.imageParser->ParseAsync(tex_name);
+    }
+
     for (usize i = 0; i < m_desc.textures.size(); i++) {
         auto& tex_name = m_desc.textures[i];
         if (tex_name.empty()) continue;
@@ -115,15 +134,17 @@ void CustomShaderPass::prepare(Scene& scene, const Device& device, RenderingReso
             if (! opt.has_value()) continue;
             img_slots.slots = { opt.value() };
         } else {
-            auto image = scene.imageParser->Parse(tex_name);
+            utils::ThreadPool::Global().Wait(images[i]);
+            auto image = images[i].get();
             if (image) {
-                img_slots = device.tex_cache().CreateTex(*image);
+                img_slots = device.tex_cache().CreateTex(image);
             } else {
                 LOG_ERROR("parse tex \"%s\" failed", tex_name.c_str());
             }
         }
         m_desc.vk_textures[i] = img_slots;
     }
+    m_desc.tex_generation = device.tex_cache().Generation();
     {
         auto& tex_name = m_desc.output;
         assert(IsSpecTex(tex_name));
@@ -144,9 +165,22 @@ void CustomShaderPass::prepare(Scene& scene, const Device& device, RenderingReso
     {
         SceneShader& shader = *(mesh.Material()->customShader.shader);
 
-        if (! GenReflect(shader.codes, spvs, ref)) {
-            LOG_ERROR("gen spv reflect failed, %s", shader.name.c_str());
-            return;
+        if (auto it = rr.reflected_shaders.find(&shader); it != rr.reflected_shaders.end()) {
+            for (const auto& spv : it->second.spvs) {
+                spvs.push_back(std::make_unique<ShaderSpv>(spv));
+            }
+            ref = it->second.ref;
+        } else {
+            // reflected when built or loaded with the shader cache
+            bool loaded = ! shader.reflection.empty() &&
+                          LoadReflect(shader.reflection, shader.codes, spvs, ref);
+            if (! loaded && ! GenReflect(shader.codes, spvs, ref)) {
+                LOG_ERROR("gen spv reflect failed, %s", shader.name.c_str());
+                return;
+            }
+            auto& reflected = rr.reflected_shaders[&shader];
+            for (const auto& spv : spvs) reflected.spvs.push_back(*spv);
+            reflected.ref = ref;
         }
 
         auto& bindings = descriptor_info.bindings;
@@ -233,9 +267,10 @@ void CustomShaderPass::prepare(Scene& scene, const Device& device, RenderingReso
             }
         }
     }
+    auto               pipeline = std::make_unique<GraphicsPipeline>();
+    VkAttachmentLoadOp loadOp { VK_ATTACHMENT_LOAD_OP_DONT_CARE };
     {
         VkPipelineColorBlendAttachmentState color_blend;
-        VkAttachmentLoadOp                  loadOp { VK_ATTACHMENT_LOAD_OP_DONT_CARE };
         {
             VkColorComponentFlags colorMask =
                 VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT;
@@ -251,39 +286,14 @@ void CustomShaderPass::prepare(Scene& scene, const Device& device, RenderingReso
 
             SetAttachmentLoadOp(blendmode, loadOp);
         }
-        auto opt = CreateRenderPass(device.handle(),
-                                    VK_FORMAT_R8G8B8A8_UNORM,
-                                    loadOp,
-                                    VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-        if (! opt.has_value()) return;
-        auto& pass = opt.value();
-
         descriptor_info.push_descriptor = true;
-        GraphicsPipeline pipeline;
-        pipeline.toDefault();
-        pipeline.addDescriptorSetInfo(spanone { descriptor_info })
+        pipeline->addDescriptorSetInfo(spanone { descriptor_info })
             .setColorBlendStates(spanone { color_blend })
             .setTopology(m_desc.index_buf ? VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST
                                           : VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP)
             .addInputBindingDescription(bind_descriptions)
             .addInputAttributeDescription(attr_descriptions);
-        for (auto& spv : spvs) pipeline.addStage(std::move(spv));
-
-        if (! pipeline.create(device, pass, m_desc.pipeline)) return;
-    }
-
-    {
-        VkFramebufferCreateInfo info {
-            .sType           = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
-            .pNext           = nullptr,
-            .renderPass      = *m_desc.pipeline.pass,
-            .attachmentCount = 1,
-            .pAttachments    = &m_desc.vk_output.view,
-            .width           = m_desc.vk_output.extent.width,
-            .height          = m_desc.vk_output.extent.height,
-            .layers          = 1,
-        };
-        VVK_CHECK_VOID_RE(device.handle().CreateFramebuffer(info, m_desc.fb));
+        for (auto& spv : spvs) pipeline->addStage(std::move(spv));
     }
 
     if (! ref.blocks.empty()) {
@@ -322,26 +332,40 @@ void CustomShaderPass::prepare(Scene& scene, const Device& device, RenderingReso
             };
         }
 
-        auto  block  = ref.blocks.front();
+        auto& block  = ref.blocks.front();
         auto* buf    = rr.dyn_buf;
         auto* bufref = &m_desc.ubo_buf;
 
+        // names are looked up once here, updates are indexed writes
+        auto& table = m_desc.uniform_table;
+        table.assign((usize)UniformId::COUNT, {});
+        for (usize i = 0; i < table.size(); i++) {
+            auto it = block.member_map.find(UniformName((UniformId)i));
+            if (it == block.member_map.end()) continue;
+            table[i] = { .offset = it->second.offset, .bound = true };
+        }
+        auto& values = m_desc.ubo_values;
+        values.assign(bufref->size, 0);
+
         auto* node           = m_desc.node;
         auto* shader_updater = scene.shaderValueUpdater.get();
         auto& sprites        = m_desc.sprites_map;
         auto& vk_textures    = m_desc.vk_textures;
 
         m_desc.update_op = [shader_updater,
-                            block,
                             buf,
                             bufref,
                             node,
+                            &table,
+                            &values,
                             &sprites,
                             &vk_textures,
                             update_dyn_buf_op]() {
-            auto update_unf_op = [&block, buf, bufref](std::string_view       name,
-                                                       wallpaper::ShaderValue value) {
-                UpdateUniform(buf, *bufref, block, name, value);
+            auto update_unf_op = [&table, &values, buf, bufref](UniformId          id,
+                                                                const ShaderValue& value) {
+                if ((usize)id >= table.size()) return;
+                const auto& binding = table[(usize)id];
+                if (binding.bound) WriteUniform(buf, *bufref, values, binding.offset, value);
             };
             shader_updater->UpdateUniforms(node, sprites, update_unf_op);
             // update image slot for sprites
@@ -354,8 +378,8 @@ void CustomShaderPass::prepare(Scene& scene, const Device& device, RenderingReso
             if (update_dyn_buf_op) update_dyn_buf_op();
         };
 
-        auto exists_unf_op = [&block](std::string_view name) {
-            return exists(block.member_map, name);
+        auto exists_unf_op = [&table](UniformId id) {
+            return (usize)id < table.size() && table[(usize)id].bound;
         };
         shader_updater->InitUniforms(node, exists_unf_op);
 
@@ -365,11 +389,9 @@ void CustomShaderPass::prepare(Scene& scene, const Device& device, RenderingReso
             auto&      default_values = mesh.Material()->customShader.shader->default_uniforms;
             auto&      const_values   = mesh.Material()->customShader.constValues;
             std::array values_array   = { &default_values, &const_values };
-            for (auto& values : values_array) {
-                for (auto& v : *values) {
-                    if (exists(block.member_map, v.first)) {
-                        UpdateUniform(buf, *bufref, block, v.first, v.second);
-                    }
+            for (auto* uniforms : values_array) {
+                for (auto& v : *uniforms) {
+                    UpdateUniform(buf, *bufref, values, block, v.first, v.second);
                 }
             }
         }
@@ -385,10 +407,52 @@ void CustomShaderPass::prepare(Scene& scene, const Device& device, RenderingReso
     for (auto& tex : releaseTexs()) {
         device.tex_cache().MarkShareReady(tex);
     }
-    setPrepared();
+
+    // the driver compiles the pipeline on the worker pool, the pass is skipped until then
+    m_prepare_job = utils::ThreadPool::Global().Post(
+        [this, &device, loadOp, pipeline = std::move(pipeline)]() {
+            auto opt = CreateRenderPass(device.handle(),
+                                        VK_FORMAT_R8G8B8A8_UNORM,
+                                        loadOp,
+                                        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+            if (! opt.has_value()) return;
+            if (! pipeline->create(device, opt.value(), m_desc.pipeline)) return;
+
+            VkFramebufferCreateInfo info {
+                .sType           = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+                .pNext           = nullptr,
+                .renderPass      = *m_desc.pipeline.pass,
+                .attachmentCount = 1,
+                .pAttachments    = &m_desc.vk_output.view,
+                .width           = m_desc.vk_output.extent.width,
+                .height          = m_desc.vk_output.extent.height,
+                .layers          = 1,
+            };
+            VVK_CHECK_VOID_RE(device.handle().CreateFramebuffer(info, m_desc.fb));
+            setPrepared();
+        });
+}
+
+bool CustomShaderPass::preparing() const {
+    return m_prepare_job.valid() &&
+           m_prepare_job.wait_for(std::chrono::seconds(0)) != std::future_status::ready;
 }
 
-void CustomShaderPass::execute(const Device&, RenderingResources& rr) {
+void CustomShaderPass::execute(const Device& device, RenderingResources& rr) {
+    auto& tex_cache = device.tex_cache();
+    if (m_desc.tex_generation != tex_cache.Generation()) {
+        // replaced by streaming or residency, look up the new images
+        for (usize i = 0; i < m_desc.vk_textures.size(); i++) {
+            auto& tex_name = m_desc.textures[i];
+            if (tex_name.empty() || IsSpecTex(tex_name)) continue;
+            if (auto* slots = tex_cache.Find(tex_name); slots != nullptr) {
+                auto active                  = m_desc.vk_textures[i].active;
+                m_desc.vk_textures[i]        = *slots;
+                m_desc.vk_textures[i].active = active;
+            }
+        }
+        m_desc.tex_generation = tex_cache.Generation();
+    }
     if (m_desc.update_op) m_desc.update_op();
 
     auto&                   cmd    = rr.command;
@@ -405,6 +469,11 @@ void CustomShaderPass::execute(const Device&, RenderingResources& rr) {
         int   binding = m_desc.vk_tex_binding[i];
         if (binding < 0) continue;
         if (slot.slots.empty()) continue;
+        if (! IsSpecTex(m_desc.textures[i])) {
+            usize active =
+                slot.active > 0 && slot.active < std::ssize(slot.slots) ? (usize)slot.active : 0;
+            tex_cache.MarkUsed(m_desc.textures[i], active);
+        }
         auto&                 img = slot.getActive();
         VkDescriptorImageInfo desc_img { img.sampler,
                                          img.view,
@@ -439,7 +508,7 @@ void CustomShaderPass::execute(const Device&, RenderingResources& rr) {
 
     if (m_desc.ubo_buf) {
         VkDescriptorBufferInfo desc_buf {
-            rr.dyn_buf->gpuBuf(),
+            rr.dyn_buf->gpuBuf(m_desc.ubo_buf),
             m_desc.ubo_buf.offset,
             m_desc.ubo_buf.size,
         };
@@ -484,14 +553,17 @@ void CustomShaderPass::execute(const Device&, RenderingResources& rr) {
     cmd.SetViewport(0, viewport);
     cmd.SetScissor(0, scissor);
 
-    auto gpu_buf = m_desc.dyn_vertex ? rr.dyn_buf->gpuBuf() : rr.vertex_buf->gpuBuf();
+    // refs may be in different blocks of the buffer
+    auto* vbuf = m_desc.dyn_vertex ? rr.dyn_buf : rr.vertex_buf;
 
     for (usize i = 0; i < m_desc.vertex_bufs.size(); i++) {
-        auto& buf = m_desc.vertex_bufs[i];
+        auto& buf     = m_desc.vertex_bufs[i];
+        auto  gpu_buf = vbuf->gpuBuf(buf);
         cmd.BindVertexBuffers((u32)i, 1, &gpu_buf, &buf.offset);
     }
     if (m_desc.index_buf) {
-        cmd.BindIndexBuffer(gpu_buf, m_desc.index_buf.offset, VK_INDEX_TYPE_UINT16);
+        cmd.BindIndexBuffer(
+            vbuf->gpuBuf(m_desc.index_buf), m_desc.index_buf.offset, VK_INDEX_TYPE_UINT16);
         cmd.DrawIndexed(m_desc.draw_count, 1, 0, 0, 0);
     } else {
         cmd.Draw(m_desc.draw_count, 1, 0, 0);
@@ -501,6 +573,7 @@ void CustomShaderPass::execute(const Device&, RenderingResources& rr) {
 }
 
 void CustomShaderPass::destory(const Device&, RenderingResources& rr) {
+    if (m_prepare_job.valid()) utils::ThreadPool::Global().Wait(m_prepare_job);
     m_desc.update_op = {};
     {
         auto& buf = m_desc.dyn_vertex ? rr.dyn_buf : rr.vertex_buf;
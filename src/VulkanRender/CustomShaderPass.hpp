@@ -1,5 +1,6 @@
 #pragma once
 #include "VulkanPass.hpp"
+#include <future>
 #include <string>
 #include <vector>
 
@@ -18,6 +19,12 @@ namespace vulkan
 
 class CustomShaderPass : public VulkanPass {
 public:
+    // scene uniform in the ubo
+    struct UniformBinding {
+        u32  offset { 0 };
+        bool bound { false };
+    };
+
     struct Desc {
         // in
         SceneNode*               node { nullptr };
@@ -30,6 +37,8 @@ public:
         std::vector<ImageSlotsRef> vk_textures;
         std::vector<i32>           vk_tex_binding;
         ImageParameters            vk_output;
+        // tex cache generation of vk_textures
+        u64 tex_generation { 0 };
 
         // bufs
         bool                          dyn_vertex { false };
@@ -45,6 +54,10 @@ public:
         u32                draw_count { 0 };
 
         // uniforms
+        // by UniformId, compiled from the reflected block
+        std::vector<UniformBinding> uniform_table;
+        // content of ubo_buf as last written, unchanged values are skipped
+        std::vector<uint8_t>  ubo_values;
         std::function<void()> update_op;
     };
 
@@ -56,9 +69,12 @@ public:
     void prepare(Scene&, const Device&, RenderingResources&) override;
     void execute(const Device&, RenderingResources&) override;
     void destory(const Device&, RenderingResources&) override;
+    bool preparing() const override;
 
 private:
     Desc m_desc;
+    // render pass, pipeline and framebuffer creation
+    std::future<void> m_prepare_job;
 };
 
 } // namespace vulkan
@@ -194,6 +194,8 @@ void FinPass::execute(const Device& device, RenderingResources& rr) {
 
     };
     {
+        // the present image changes every frame, the last framebuffer may still be in flight
+        if (m_desc.fb) device.Retire(std::move(m_desc.fb));
         m_desc.fb = {};
         VkFramebufferCreateInfo info {
             .sType           = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
@@ -273,8 +275,10 @@ void FinPass::execute(const Device& device, RenderingResources& rr) {
     cmd.SetViewport(0, viewport);
     cmd.SetScissor(0, scissor);
 
-    cmd.BindVertexBuffers(
-        0, 1, std::array { rr.vertex_buf->gpuBuf() }.data(), &m_desc.vertex_buf.offset);
+    cmd.BindVertexBuffers(0,
+                          1,
+                          std::array { rr.vertex_buf->gpuBuf(m_desc.vertex_buf) }.data(),
+                          &m_desc.vertex_buf.offset);
     cmd.Draw(4, 1, 0, 0);
     cmd.EndRenderPass();
 
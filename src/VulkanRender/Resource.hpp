@@ -1,22 +1,48 @@
 #pragma once
 #include "Core/NoCopyMove.hpp"
 #include "Vulkan/StagingBuffer.hpp"
+#include "Vulkan/Shader.hpp"
 #include <memory>
+#include <unordered_map>
+#include <vector>
 
 namespace wallpaper
 {
+struct SceneShader;
+
 namespace vulkan
 {
 
-struct RenderingResources {
+// materials built from the same source share a SceneShader, reflect it once
+struct ReflectedShader {
+    std::vector<ShaderSpv> spvs;
+    ShaderReflected        ref;
+};
+
+// one for each frame in flight
+struct FrameResources {
     vvk::CommandBuffer command;
+    // dyn_buf upload, recorded after the passes wrote it and submitted before them
+    vvk::CommandBuffer upload_command;
 
     vvk::Semaphore sem_swap_wait_image;
     vvk::Semaphore sem_swap_finish;
     vvk::Fence     fence_frame;
+};
 
+struct RenderingResources {
+    // of the frame being recorded
+    vvk::CommandBuffer command;
+
+    std::vector<FrameResources> frames;
+
+    // uploaded once when the render graph is compiled
     StagingBuffer* vertex_buf;
+    // a region for each frame in flight
     StagingBuffer* dyn_buf;
+
+    // cleared with the render graph, while the scene keeps the shaders alive
+    std::unordered_map<const SceneShader*, ReflectedShader> reflected_shaders;
 };
 } // namespace vulkan
 } // namespace wallpaper
@@ -1,5 +1,6 @@
 #pragma once
 #include "RenderGraph/Pass.hpp"
+#include <atomic>
 #include <span>
 #include <vector>
 #include <string>
@@ -25,6 +26,9 @@ public:
     virtual void prepare(Scene&, const Device&, RenderingResources&) = 0;
     virtual void execute(const Device&, RenderingResources&)         = 0;
     virtual void destory(const Device&, RenderingResources&)         = 0;
+    // prepare may leave work on the worker pool, which sets prepared() if it succeeds
+    // true until that work is done
+    virtual bool preparing() const { return false; }
 
     void addReleaseTexs(std::span<const std::string_view> texs) {
         m_release_texs.clear();
@@ -32,15 +36,15 @@ public:
             return std::string(sv);
         });
     }
-    bool                         prepared() const { return m_prepared; }
+    bool prepared() const { return m_prepared.load(std::memory_order_acquire); }
     std::span<const std::string> releaseTexs() const { return m_release_texs; }
     void                         clearReleaseTexs() { m_release_texs.clear(); }
 
 protected:
-    void setPrepared(bool v = true) { m_prepared = v; }
+    void setPrepared(bool v = true) { m_prepared.store(v, std::memory_order_release); }
 
 private:
-    bool                     m_prepared { false };
+    std::atomic<bool>        m_prepared { false };
     std::vector<std::string> m_release_texs;
 };
 } // namespace vulkan
@@ -6,6 +6,7 @@
 #include "Interface/IShaderValueUpdater.h"
 
 #include "Utils/Algorism.h"
+#include "Utils/Trace.h"
 
 #include <glslang/Public/ShaderLang.h>
 
@@ -21,6 +22,7 @@
 
 #include "Core/ArrayHelper.hpp"
 
+#include <algorithm>
 #include <cassert>
 #include <vector>
 #include <cstdint>
@@ -32,7 +34,7 @@
 using namespace wallpaper::vulkan;
 
 constexpr uint64_t vk_wait_time { 10u * 1000u * 1000000u };
-constexpr uint32_t vk_command_num { 2 };
+constexpr uint32_t vk_frames_in_flight_max { 4 };
 
 constexpr std::array base_inst_exts {
     Extension { false, VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME },
@@ -61,11 +63,16 @@ struct VulkanRender::Impl {
     void clearLastRenderGraph();
     void compileRenderGraph(Scene&, rg::RenderGraph&);
     void UpdateCameraFillMode(Scene&, wallpaper::FillMode);
+    void setVramBudget(usize);
+    void setTexTranscode(const ImageTranscode&);
 
     bool initRes();
+    bool beginFrame();
     void drawFrameSwapchain();
     void drawFrameOffscreen();
+    bool recordFrame(FrameResources&);
     void setRenderTargetSize(Scene&, rg::RenderGraph&);
+    void updatePassRun(Scene&);
 
     Instance                m_instance;
     std::unique_ptr<Device> m_device;
@@ -81,16 +88,28 @@ struct VulkanRender::Impl {
 
     vvk::CommandBuffers m_cmds;
     vvk::CommandBuffer  m_upload_cmd;
-    vvk::CommandBuffer  m_render_cmd;
+
+    uint32_t m_frames_in_flight { 2 };
+    // serial of the frame being recorded
+    u64 m_frame { 0 };
 
     bool m_with_surface { false };
     bool m_inited { false };
     bool m_pass_loaded { false };
 
+    usize          m_vram_budget { 0 };
+    ImageTranscode m_tex_transcode;
+
     std::unique_ptr<VulkanExSwapchain> m_ex_swapchain;
     RenderingResources                 m_rendering_resources;
 
     std::vector<VulkanPass*> m_passes;
+    // indexes of the passes writing the targets each pass samples
+    std::vector<std::vector<usize>> m_pass_deps;
+    // passes executed this frame
+    std::vector<bool> m_pass_run;
+    // no pass is preparing on the worker pool any more
+    bool m_passes_settled { false };
 };
 
 VulkanRender::VulkanRender(): pImpl(std::make_unique<Impl>()) {}
@@ -109,12 +128,18 @@ void VulkanRender::UpdateCameraFillMode(Scene& scene, wallpaper::FillMode fill)
     pImpl->UpdateCameraFillMode(scene, fill);
 };
 
+void VulkanRender::setVramBudget(usize bytes) { pImpl->setVramBudget(bytes); }
+void VulkanRender::setTexTranscode(const ImageTranscode& v) { pImpl->setTexTranscode(v); }
+
 wallpaper::ExSwapchain* VulkanRender::exSwapchain() const { return pImpl->m_ex_swapchain.get(); };
 
 bool VulkanRender::Impl::init(RenderInitInfo info) {
     if (m_inited) return true;
 
     m_redraw_cb = info.redraw_callback;
+    // offscreen images are handed over once rendered, it waits every frame
+    m_frames_in_flight =
+        info.offscreen ? 1 : std::clamp(info.frames_in_flight, 1u, vk_frames_in_flight_max);
     VkExtent2D extent { info.width, info.height };
     if (extent.width * extent.height < 500 * 500) {
         LOG_ERROR("too small swapchain image size: %dx%d", extent.width, extent.height);
@@ -171,6 +196,8 @@ bool VulkanRender::Impl::init(RenderInitInfo info) {
             LOG_ERROR("init vulkan device failed");
             return false;
         }
+        m_device->tex_cache().residency().SetBudget(m_vram_budget);
+        m_device->tex_cache().SetTranscode(m_tex_transcode);
     }
 
     if (info.offscreen) {
@@ -217,14 +244,15 @@ bool VulkanRender::Impl::initRes() {
                                                 2 * 1024 * 1024,
                                                 VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
                                                     VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
-                                                    VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+                                                    VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                                                m_frames_in_flight);
     if (! m_vertex_buf->allocate()) return false;
     if (! m_dyn_buf->allocate()) return false;
     {
         auto& pool = m_device->cmd_pool();
-        VVK_CHECK_BOOL_RE(pool.Allocate(vk_command_num, VK_COMMAND_BUFFER_LEVEL_PRIMARY, m_cmds));
+        VVK_CHECK_BOOL_RE(
+            pool.Allocate(1 + 2 * m_frames_in_flight, VK_COMMAND_BUFFER_LEVEL_PRIMARY, m_cmds));
         m_upload_cmd = vvk::CommandBuffer(m_cmds[0], m_device->handle().Dispatch());
-        m_render_cmd = vvk::CommandBuffer(m_cmds[1], m_device->handle().Dispatch());
     }
     if (! CreateRenderingResource(m_rendering_resources)) return false;
 
@@ -252,23 +280,28 @@ void VulkanRender::Impl::destroy() {
 }
 
 bool VulkanRender::Impl::CreateRenderingResource(RenderingResources& rr) {
-    rr.command = m_render_cmd;
-    VVK_CHECK_BOOL_RE(m_device->handle().CreateFence(
-        VkFenceCreateInfo {
-            .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
-            .pNext = nullptr,
-            .flags = VK_FENCE_CREATE_SIGNALED_BIT,
-        },
-        rr.fence_frame));
-
-    rr.fence_frame.Reset();
+    rr.frames.resize(m_frames_in_flight);
+    for (usize i = 0; i < rr.frames.size(); i++) {
+        auto& frame          = rr.frames[i];
+        frame.command        = vvk::CommandBuffer(m_cmds[1 + 2 * i], m_device->handle().Dispatch());
+        frame.upload_command = vvk::CommandBuffer(m_cmds[2 + 2 * i], m_device->handle().Dispatch());
+        // signaled, the first wait of each frame returns at once
+        VVK_CHECK_BOOL_RE(m_device->handle().CreateFence(
+            VkFenceCreateInfo {
+                .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+                .pNext = nullptr,
+                .flags = VK_FENCE_CREATE_SIGNALED_BIT,
+            },
+            frame.fence_frame));
 
-    if (m_with_surface) {
-        VkSemaphoreCreateInfo ci { .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
-                                   .pNext = nullptr };
-        VVK_CHECK_BOOL_RE(m_device->handle().CreateSemaphore(ci, rr.sem_swap_finish));
-        VVK_CHECK_BOOL_RE(m_device->handle().CreateSemaphore(ci, rr.sem_swap_wait_image));
+        if (m_with_surface) {
+            VkSemaphoreCreateInfo ci { .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+                                       .pNext = nullptr };
+            VVK_CHECK_BOOL_RE(m_device->handle().CreateSemaphore(ci, frame.sem_swap_finish));
+            VVK_CHECK_BOOL_RE(m_device->handle().CreateSemaphore(ci, frame.sem_swap_wait_image));
+        }
     }
+    rr.command = rr.frames.front().command;
 
     rr.vertex_buf = m_vertex_buf.get();
     rr.dyn_buf    = m_dyn_buf.get();
@@ -279,8 +312,24 @@ void VulkanRender::Impl::DestroyRenderingResource(RenderingResources& rr) {}
 
 // VulkanExSwapchain* VulkanRender::exSwapchain() const { return m_ex_swapchain.get(); }
 
+void VulkanRender::Impl::setVramBudget(usize bytes) {
+    m_vram_budget = bytes;
+    if (m_device) m_device->tex_cache().residency().SetBudget(bytes);
+}
+
+void VulkanRender::Impl::setTexTranscode(const ImageTranscode& v) {
+    m_tex_transcode = v;
+    if (m_device) m_device->tex_cache().SetTranscode(v);
+}
+
 void VulkanRender::Impl::drawFrame(Scene& scene) {
     if (! (m_inited && m_pass_loaded)) return;
+    WP_TRACE_SCOPE("draw frame");
+
+    if (! beginFrame()) return;
+    // replaced samplers are retired until the frames in flight are done
+    m_device->tex_cache().UpdateStreaming();
+    m_device->tex_cache().UpdateResidency();
 
         // LOG_INFO("used ram: %fm", (m_device->GetUsage()/1024.0f)/1024.0f);
 
@@ -290,11 +339,13 @@ void VulkanRender::Impl::drawFrame(Scene& scene) {
             RENDERDOC_DEVICEPOINTER_FROM_VKINSTANCE((VkInstance)m_instance.inst()), NULL);
 #endif
 
+    updatePassRun(scene);
     if (m_instance.offscreen()) {
         drawFrameOffscreen();
     } else {
         drawFrameSwapchain();
     }
+    m_frame++;
 
     if (m_redraw_cb) m_redraw_cb();
 
@@ -305,16 +356,32 @@ void VulkanRender::Impl::drawFrame(Scene& scene) {
 #endif
 }
 
-void VulkanRender::Impl::drawFrameSwapchain() {
-    static size_t resource_index = 0;
+// the resources of a frame were last used frames_in_flight frames ago, waits for that frame
+bool VulkanRender::Impl::beginFrame() {
+    RenderingResources& rr    = m_rendering_resources;
+    usize               index = m_frame % rr.frames.size();
+    auto&               frame = rr.frames[index];
+    {
+        WP_TRACE_SCOPE("wait frame fence");
+        VVK_CHECK_BOOL_RE(frame.fence_frame.Wait(vk_wait_time));
+    }
+    // frames before the waited one are done too
+    u64 completed = m_frame >= rr.frames.size() ? m_frame - rr.frames.size() + 1 : 0;
+    m_device->SetFrame(m_frame, completed);
+    m_dyn_buf->setFrame((uint)index);
+    rr.command = frame.command;
+    return true;
+}
 
-    RenderingResources& rr = m_rendering_resources;
-    resource_index         = (resource_index + 1) % 3;
-    uint32_t image_index   = 0;
+void VulkanRender::Impl::drawFrameSwapchain() {
+    RenderingResources& rr          = m_rendering_resources;
+    auto&               frame       = rr.frames[m_frame % rr.frames.size()];
+    uint32_t            image_index = 0;
     {
+        WP_TRACE_SCOPE("acquire image");
         VVK_CHECK_VOID_RE(m_device->handle().AcquireNextImageKHR(*m_device->swapchain().handle(),
                                                                  vk_wait_time,
-                                                                 *rr.sem_swap_wait_image,
+                                                                 *frame.sem_swap_wait_image,
                                                                  {},
                                                                  &image_index));
     }
@@ -322,79 +389,113 @@ void VulkanRender::Impl::drawFrameSwapchain() {
 
     m_finpass->setPresent(image);
 
-    (void)rr.command.Begin(VkCommandBufferBeginInfo {
-        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-        .pNext = nullptr,
-        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
-    });
-    m_dyn_buf->recordUpload(rr.command);
-    for (auto* p : m_passes) {
-        if (p->prepared()) {
-            p->execute(*m_device, rr);
-        }
-    }
-    (void)rr.command.End();
+    if (! recordFrame(frame)) return;
 
+    std::array           cmds { *frame.upload_command, *frame.command };
     VkPipelineStageFlags wait_dst_stage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
     VkSubmitInfo         sub_info {
                 .sType                = VK_STRUCTURE_TYPE_SUBMIT_INFO,
                 .pNext                = nullptr,
                 .waitSemaphoreCount   = 1,
-                .pWaitSemaphores      = rr.sem_swap_wait_image.address(),
+                .pWaitSemaphores      = frame.sem_swap_wait_image.address(),
                 .pWaitDstStageMask    = &wait_dst_stage,
-                .commandBufferCount   = 1,
-                .pCommandBuffers      = rr.command.address(),
+                .commandBufferCount   = (uint32_t)cmds.size(),
+                .pCommandBuffers      = cmds.data(),
                 .signalSemaphoreCount = 1,
-                .pSignalSemaphores    = rr.sem_swap_finish.address(),
+                .pSignalSemaphores    = frame.sem_swap_finish.address(),
     };
 
-    VVK_CHECK_VOID_RE(m_device->present_queue().handle.Submit(sub_info, *rr.fence_frame));
+    VVK_CHECK_VOID_RE(frame.fence_frame.Reset());
+    VVK_CHECK_VOID_RE(m_device->present_queue().handle.Submit(sub_info, *frame.fence_frame));
     VkPresentInfoKHR present_info {
         .sType              = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
         .pNext              = nullptr,
         .waitSemaphoreCount = 1,
-        .pWaitSemaphores    = rr.sem_swap_finish.address(),
+        .pWaitSemaphores    = frame.sem_swap_finish.address(),
         .swapchainCount     = 1,
         .pSwapchains        = m_device->swapchain().handle().address(),
         .pImageIndices      = &image_index,
     };
     VVK_CHECK_VOID_RE(m_device->present_queue().handle.Present(present_info));
-
-    VVK_CHECK_VOID_RE(rr.fence_frame.Wait(vk_wait_time));
-    VVK_CHECK_VOID_RE(rr.fence_frame.Reset());
+    // not waited here, the next frames are recorded while the gpu draws this one
 }
 void VulkanRender::Impl::drawFrameOffscreen() {
     RenderingResources& rr    = m_rendering_resources;
+    auto&               frame = rr.frames[m_frame % rr.frames.size()];
     ImageParameters     image = m_ex_swapchain->GetInprogressImage();
 
     m_finpass->setPresent(image);
 
-    (void)rr.command.Begin(VkCommandBufferBeginInfo {
+    if (! recordFrame(frame)) return;
+
+    std::array   cmds { *frame.upload_command, *frame.command };
+    VkSubmitInfo sub_info {
+        .sType              = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .pNext              = nullptr,
+        .commandBufferCount = (uint32_t)cmds.size(),
+        .pCommandBuffers    = cmds.data(),
+    };
+    VVK_CHECK_VOID_RE(frame.fence_frame.Reset());
+    VVK_CHECK_VOID_RE(m_device->graphics_queue().handle.Submit(sub_info, *frame.fence_frame));
+
+    // the image is complete when handed over
+    {
+        WP_TRACE_SCOPE("wait frame fence");
+        VVK_CHECK_VOID_RE(frame.fence_frame.Wait(vk_wait_time));
+    }
+    m_ex_swapchain->renderFrame();
+}
+
+// the passes write uniforms and dynamic vertices while recorded, the upload goes after them
+// the barrier of the upload covers the render commands, they follow it in the same submit
+bool VulkanRender::Impl::recordFrame(FrameResources& frame) {
+    RenderingResources& rr = m_rendering_resources;
+    VkCommandBufferBeginInfo begin_info {
         .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
         .pNext = nullptr,
         .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
-    });
-    m_dyn_buf->recordUpload(rr.command);
-
-    for (auto* p : m_passes) {
-        if (p->prepared()) {
-            p->execute(*m_device, rr);
+    };
+    VVK_CHECK_BOOL_RE(rr.command.Begin(begin_info));
+    for (usize i = 0; i < m_passes.size(); i++) {
+        if (m_pass_run[i]) {
+            WP_TRACE_SCOPE("pass execute");
+            m_passes[i]->execute(*m_device, rr);
         }
     }
+    VVK_CHECK_BOOL_RE(rr.command.End());
 
-    (void)rr.command.End();
+    VVK_CHECK_BOOL_RE(frame.upload_command.Begin(begin_info));
+    m_dyn_buf->recordUpload(frame.upload_command);
+    VVK_CHECK_BOOL_RE(frame.upload_command.End());
+    return true;
+}
 
-    VkSubmitInfo sub_info {
-        .sType              = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-        .pNext              = nullptr,
-        .commandBufferCount = 1,
-        .pCommandBuffers    = rr.command.address(),
-    };
-    VVK_CHECK_VOID_RE(m_device->graphics_queue().handle.Submit(sub_info, *rr.fence_frame));
+// while pipelines are created on the worker pool, a pass also waits for the passes writing the
+// targets it samples, nothing samples a target that was not drawn
+// the scene target is cleared by the prepass every frame, it shows the clear color and then the
+// layers as they get ready
+void VulkanRender::Impl::updatePassRun(Scene& scene) {
+    m_pass_run.resize(m_passes.size());
+    if (m_passes_settled) {
+        for (usize i = 0; i < m_passes.size(); i++) m_pass_run[i] = m_passes[i]->prepared();
+        return;
+    }
 
-    VVK_CHECK_VOID_RE(rr.fence_frame.Wait(vk_wait_time));
-    VVK_CHECK_VOID_RE(rr.fence_frame.Reset());
-    m_ex_swapchain->renderFrame();
+    bool              settled { true };
+    std::vector<bool> waiting(m_passes.size(), false);
+    for (usize i = 0; i < m_passes.size(); i++) {
+        auto* p    = m_passes[i];
+        bool  wait = p->preparing();
+        settled    = settled && ! wait;
+        for (usize d : m_pass_deps[i]) wait = wait || waiting[d];
+        waiting[i]    = wait;
+        m_pass_run[i] = p->prepared() && ! wait;
+    }
+    if (settled) {
+        m_passes_settled = true;
+        // all pipelines are created by now
+        if (scene.vfs) m_device->SavePipelineCache(*scene.vfs);
+    }
 }
 
 void VulkanRender::Impl::setRenderTargetSize(Scene& scene, rg::RenderGraph& rg) {
@@ -482,10 +583,14 @@ void VulkanRender::Impl::UpdateCameraFillMode(wallpaper::Scene&   scene,
 }
 
 void VulkanRender::Impl::clearLastRenderGraph() {
+    WP_TRACE_SCOPE("clear rendergraph");
+    // the frames in flight use the passes and buffers
+    VVK_CHECK(m_device->handle().WaitIdle());
     for (auto& p : m_passes) {
         p->destory(*m_device, m_rendering_resources);
     }
     m_passes.clear();
+    m_rendering_resources.reflected_shaders.clear();
     m_device->tex_cache().Clear();
 
     m_vertex_buf->destroy();
@@ -493,10 +598,12 @@ void VulkanRender::Impl::clearLastRenderGraph() {
 
     m_vertex_buf->allocate();
     m_dyn_buf->allocate();
+    m_device->SetFrame(m_frame, m_frame);
 }
 
 void VulkanRender::Impl::compileRenderGraph(Scene& scene, rg::RenderGraph& rg) {
     if (! m_inited) return;
+    WP_TRACE_SCOPE("compile rendergraph");
     m_pass_loaded = false;
 
     auto nodes             = rg.topologicalOrder();
@@ -524,15 +631,34 @@ void VulkanRender::Impl::compileRenderGraph(Scene& scene, rg::RenderGraph& rg) {
     m_passes.insert(m_passes.begin(), m_prepass.get());
     m_passes.push_back(m_finpass.get());
 
+    m_pass_deps.assign(m_passes.size(), {});
+    {
+        // node id -> index in m_passes, after the prepass
+        Map<rg::NodeID, usize> indexes;
+        for (usize i = 0; i < nodes.size(); i++) indexes[nodes[i]] = i + 1;
+        auto writers = rg.getInputWriters(nodes);
+        for (usize i = 0; i < nodes.size(); i++) {
+            for (auto id : writers[i]) {
+                if (auto it = indexes.find(id); it != indexes.end())
+                    m_pass_deps[i + 1].push_back(it->second);
+            }
+        }
+    }
+    m_passes_settled = false;
+
     setRenderTargetSize(scene, rg);
 
+    if (scene.vfs) m_device->LoadPipelineCache(*scene.vfs);
     glslang::InitializeProcess();
     for (auto* p : m_passes) {
         if (! p->prepared()) {
+            WP_TRACE_SCOPE("pass prepare");
             p->prepare(scene, *m_device, m_rendering_resources);
         }
     }
     glslang::FinalizeProcess();
+    // textures of all passes in one submit
+    m_device->tex_cache().FlushUploads();
 
     VVK_CHECK_VOID_RE(m_upload_cmd.Begin(VkCommandBufferBeginInfo {
         .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
@@ -549,7 +675,9 @@ void VulkanRender::Impl::compileRenderGraph(Scene& scene, rg::RenderGraph& rg) {
             .pCommandBuffers    = m_upload_cmd.address(),
         };
         VVK_CHECK_VOID_RE(m_device->graphics_queue().handle.Submit(sub_info, {}));
+        WP_TRACE_SCOPE("wait vertex upload");
         VVK_CHECK_VOID_RE(m_device->handle().WaitIdle());
     }
+    m_device->tex_cache().WaitUploads();
     m_pass_loaded = true;
 };
@@ -4,6 +4,7 @@
 #include "SceneWallpaperSurface.hpp"
 #include "Swapchain/ExSwapchain.hpp"
 #include "Type.hpp"
+#include "Core/Literals.hpp"
 
 #include <cstdio>
 #include <memory>
@@ -11,6 +12,7 @@
 namespace wallpaper
 {
 class Scene;
+struct ImageTranscode;
 
 namespace vulkan
 {
@@ -30,6 +32,10 @@ public:
     void clearLastRenderGraph();
     void compileRenderGraph(Scene&, rg::RenderGraph&);
     void UpdateCameraFillMode(Scene&, wallpaper::FillMode);
+    // bytes, textures are shrunk above it, 0 uses the driver budget only
+    void setVramBudget(usize);
+    // block compression of rgba8 textures, used by the next loaded scene
+    void setTexTranscode(const ImageTranscode&);
 
     ExSwapchain* exSwapchain() const;
     bool inited() const;
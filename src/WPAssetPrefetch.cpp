@@ -0,0 +1,122 @@
+#include "WPAssetPrefetch.hpp"
+#include "WPJson.hpp"
+
+#include <nlohmann/json.hpp>
+
+#include "Fs/VFS.h"
+#include "Fs/MemBinaryStream.h"
+#include "Core/MapSet.hpp"
+#include "Core/StringHelper.hpp"
+#include "Utils/ThreadPool.hpp"
+#include "Utils/Trace.h"
+#include "Utils/Logging.h"
+
+#include <unistd.h>
+
+using namespace wallpaper;
+
+namespace
+{
+
+constexpr std::string_view asset_base { "/assets/" };
+
+// memory backed content of path, pages of mapped files are touched to load them
+std::shared_ptr<fs::IBinaryStream> ReadContent(fs::VFS& vfs, const std::string& path) {
+    WP_TRACE_SCOPE("prefetch read");
+    auto file = vfs.OpenFromMount(path);
+    if (! file) return nullptr;
+
+    auto data = file->Data();
+    if (data.empty()) return std::make_shared<fs::MemBinaryStream>(*file);
+
+    static const usize page = (usize)::sysconf(_SC_PAGESIZE);
+    volatile uint8_t   sink { 0 };
+    for (usize i = 0; i < data.size(); i += page) sink = sink + (uint8_t)data[i];
+    return file;
+}
+
+class Scanner {
+public:
+    explicit Scanner(fs::VFS& vfs): m_vfs(vfs) {}
+
+    void ScanJson(std::string_view src) {
+        nlohmann::json json;
+        if (! PARSE_JSON(std::string(src), json)) return;
+        walk(json);
+    }
+
+private:
+    void walk(const nlohmann::json& json) {
+        if (json.is_object()) {
+            for (auto& [key, value] : json.items()) {
+                if (key == "shader" && value.is_string()) {
+                    std::string shader = "shaders/" + value.get<std::string>();
+                    fetch(shader + ".vert");
+                    fetch(shader + ".frag");
+                } else if (key == "textures" && value.is_array()) {
+                    for (auto& tex : value) {
+                        if (! tex.is_string()) continue;
+                        auto name = tex.get<std::string>();
+                        // render targets
+                        if (sstart_with(name, "_rt_")) continue;
+                        fetch("materials/" + name + ".tex");
+                    }
+                } else {
+                    walk(value);
+                }
+            }
+        } else if (json.is_array()) {
+            for (auto& el : json) walk(el);
+        } else if (json.is_string()) {
+            const auto& str = json.get_ref<const std::string&>();
+            if (send_with(str, ".json")) {
+                fetchJson(str);
+            } else if (send_with(str, ".mdl") || send_with(str, ".tex") ||
+                       send_with(str, ".mp3") || send_with(str, ".ogg") ||
+                       send_with(str, ".wav")) {
+                fetch(str);
+            }
+        }
+    }
+
+    bool mark(const std::string& path) {
+        if (! m_vfs.Contains(path) || m_vfs.IsPrefetched(path)) return false;
+        return m_visited.insert(path).second;
+    }
+
+    void fetch(const std::string& rpath) {
+        std::string path = std::string(asset_base) + rpath;
+        if (! mark(path)) return;
+        auto& vfs = m_vfs;
+        m_vfs.AddPrefetched(path, utils::ThreadPool::Global().Post([&vfs, path]() {
+                                      return ReadContent(vfs, path);
+                                  }).share());
+    }
+
+    // json files are small, read and scan them in place
+    void fetchJson(const std::string& rpath) {
+        std::string path = std::string(asset_base) + rpath;
+        if (! mark(path)) return;
+        auto content = ReadContent(m_vfs, path);
+        if (! content) return;
+        std::promise<std::shared_ptr<fs::IBinaryStream>> ready;
+        ready.set_value(content);
+        m_vfs.AddPrefetched(path, ready.get_future().share());
+
+        auto data = content->Data();
+        ScanJson({ (const char*)data.data(), data.size() });
+    }
+
+    fs::VFS&      m_vfs;
+    StringHashSet m_visited;
+};
+
+} // namespace
+
+void WPAssetPrefetch::Prefetch(const std::string& scene_src, fs::VFS& vfs) {
+    auto job = utils::ThreadPool::Global().Post([&vfs, scene_src]() {
+        WP_TRACE_SCOPE("prefetch scan");
+        Scanner(vfs).ScanJson(scene_src);
+    });
+    vfs.AddPrefetchJob(job.share());
+}
@@ -0,0 +1,19 @@
+#pragma once
+#include <string>
+
+namespace wallpaper
+{
+namespace fs
+{
+class VFS;
+}
+
+// read assets referenced by a scene ahead of the parser, on the thread pool
+class WPAssetPrefetch {
+public:
+    // scan scene json and the json files it references (models, materials, effects,
+    // particles) for textures, shaders, models and sounds, queue reads of them into vfs
+    // vfs must keep its mounts unchanged until vfs.ClearPrefetched()
+    static void Prefetch(const std::string& scene_src, fs::VFS&);
+};
+} // namespace wallpaper
@@ -2,13 +2,16 @@
 #include <string_view>
 #include <charconv>
 #include "Fs/IBinaryStream.h"
+#include "Fs/BinaryReader.h"
 #include "Utils/Logging.h"
 #include "Core/StringHelper.hpp"
 
 namespace wallpaper
 {
 
-inline int32_t ReadVersion(std::string_view prefix, fs::IBinaryStream& file) {
+// TReader: fs::IBinaryStream or fs::BinaryReader
+template<typename TReader>
+inline int32_t ReadVersion(std::string_view prefix, TReader& file) {
     char str_v[9] { '\0' };
     file.Read(str_v, 9);
     if (! sstart_with(str_v, prefix)) return 0;
@@ -28,11 +31,42 @@ inline void WriteVersion(std::string_view prefix, fs::IBinaryStreamW& file, int
     file.Write(buf, sizeof(buf));
 }
 
-inline int32_t ReadTexVesion(fs::IBinaryStream& file) { return ReadVersion("TEX", file); }
-inline int32_t ReadMDLVesion(fs::IBinaryStream& file) { return ReadVersion("MDL", file); }
+template<typename TReader>
+inline int32_t ReadTexVesion(TReader& file) {
+    return ReadVersion("TEX", file);
+}
+template<typename TReader>
+inline int32_t ReadMDLVesion(TReader& file) {
+    return ReadVersion("MDL", file);
+}
 
 // DIY
-inline int32_t ReadSPVVesion(fs::IBinaryStream& file) { return ReadVersion("SPV", file); }
+template<typename TReader>
+inline int32_t ReadSPVVesion(TReader& file) {
+    return ReadVersion("SPV", file);
+}
 inline void WriteSPVVesion(fs::IBinaryStreamW& file, int ver) { WriteVersion("SPVS", file, ver); }
 
+template<typename TReader>
+inline int32_t ReadTexCacheVesion(TReader& file) {
+    return ReadVersion("TEXC", file);
+}
+inline void WriteTexCacheVesion(fs::IBinaryStreamW& file, int ver) {
+    WriteVersion("TEXC", file, ver);
+}
+template<typename TReader>
+inline int32_t ReadTexIndexVesion(TReader& file) {
+    return ReadVersion("TIDX", file);
+}
+inline void WriteTexIndexVesion(fs::IBinaryStreamW& file, int ver) {
+    WriteVersion("TIDX", file, ver);
+}
+template<typename TReader>
+inline int32_t ReadCacheArchiveVesion(TReader& file) {
+    return ReadVersion("CARC", file);
+}
+inline void WriteCacheArchiveVesion(fs::IBinaryStreamW& file, int ver) {
+    WriteVersion("CARC", file, ver);
+}
+
 } // namespace wallpaper
@@ -1,7 +1,6 @@
 #include "WPMdlParser.hpp"
 #include "Fs/VFS.h"
-#include "Fs/IBinaryStream.h"
-#include "Fs/MemBinaryStream.h"
+#include "Fs/BinaryReader.h"
 #include "WPCommon.hpp"
 #include "Utils/Logging.h"
 #include "Scene/SceneMesh.h"
@@ -42,9 +41,8 @@ constexpr uint32_t singile_bone_frame = 4 * 9;
 bool WPMdlParser::Parse(std::string_view path, fs::VFS& vfs, WPMdl& mdl) {
     auto str_path = std::string(path);
     auto pfile    = vfs.Open("/assets/" + str_path);
-    auto memfile  = fs::MemBinaryStream(*pfile);
     if (! pfile) return false;
-    auto& f = memfile;
+    fs::StreamReader f(pfile);
 
     mdl.mdlv = ReadMDLVesion(f);
 
@@ -68,7 +66,7 @@ bool WPMdlParser::Parse(std::string_view path, fs::VFS& vfs, WPMdl& mdl) {
     // located after the herald value, and we'll need to account for other differences later on.
     if(curr == 0){
         alt_mdl_format = true;
-        while (curr != alt_format_vertex_size_herald_value){
+        while (curr != alt_format_vertex_size_herald_value && f.ok()){
             curr = f.ReadUint32();
         }
         curr = f.ReadUint32();
@@ -88,11 +86,15 @@ bool WPMdlParser::Parse(std::string_view path, fs::VFS& vfs, WPMdl& mdl) {
     uint32_t vertex_num = vertex_size / (alt_mdl_format ? alt_singile_vertex : singile_vertex);
     mdl.vertexs.resize(vertex_num);
     for (auto& vert : mdl.vertexs) {
-        for (auto& v : vert.position) v = f.ReadFloat();
-        if(alt_mdl_format) {for (int i = 0; i < 7; i++) f.ReadUint32();}
-        for (auto& v : vert.blend_indices) v = f.ReadUint32();
-        for (auto& v : vert.weight) v = f.ReadFloat();
-        for (auto& v : vert.texcoord) v = f.ReadFloat();
+        f.ReadArray(std::span(vert.position));
+        if(alt_mdl_format) f.Skip(7 * sizeof(uint32_t));
+        f.ReadArray(std::span(vert.blend_indices));
+        f.ReadArray(std::span(vert.weight));
+        f.ReadArray(std::span(vert.texcoord));
+    }
+    if (! f.ok()) {
+        LOG_ERROR("mdl '%s' truncated at vertices", str_path.c_str());
+        return false;
     }
 
     uint32_t indices_size = f.ReadUint32();
@@ -104,7 +106,7 @@ bool WPMdlParser::Parse(std::string_view path, fs::VFS& vfs, WPMdl& mdl) {
     uint32_t indices_num = indices_size / singile_indices;
     mdl.indices.resize(indices_num);
     for (auto& id : mdl.indices) {
-        for (auto& v : id) v = f.ReadUint16();
+        f.ReadArray(std::span(id));
     }
 
     mdl.mdls = ReadMDLVesion(f);
@@ -203,15 +205,12 @@ bool WPMdlParser::Parse(std::string_view path, fs::VFS& vfs, WPMdl& mdl) {
                 for(int i = 0; i < num_attachments; i++){
                     f.ReadUint16(); // skip 2 bytes
                     std::string attachment_name = f.ReadStr(); // attachment name
-                    int bytesToRead = mdat_attachment_data_byte_length;
-                    for(int j = 0; j < bytesToRead; j++){
-                        f.ReadUint8();
-                    }
+                    f.Skip(mdat_attachment_data_byte_length);
 
                 }
             }
         }
-    } while (mdType != "MDLA");
+    } while (mdType != "MDLA" && f.ok());
     
 
     if(mdType == "MDLA" && mdVersion.length() > 0){
@@ -225,7 +224,7 @@ bool WPMdlParser::Parse(std::string_view path, fs::VFS& vfs, WPMdl& mdl) {
             for (auto& anim : anims) {
                 // there can be a variable number of 32-bit 0s between animations
                 anim.id = 0;
-                while(anim.id == 0){
+                while(anim.id == 0 && f.ok()){
                     anim.id = f.ReadInt32();
                 }
     
@@ -287,6 +286,10 @@ bool WPMdlParser::Parse(std::string_view path, fs::VFS& vfs, WPMdl& mdl) {
         }
     }
     
+    if (! f.ok()) {
+        LOG_ERROR("mdl '%s' truncated", str_path.c_str());
+        return false;
+    }
     mdl.puppet->prepared();
 
     LOG_INFO("read puppet: mdlv: %d, nmdls: %d, mdla: %d, bones: %d, anims: %d",
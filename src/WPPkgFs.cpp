@@ -1,7 +1,7 @@
 #include "WPPkgFs.hpp"
 #include "Utils/Logging.h"
-#include "Fs/LimitedBinaryStream.h"
-#include "Fs/CBinaryStream.h"
+#include "Fs/SpanBinaryStream.h"
+#include "Fs/BinaryReader.h"
 #include <vector>
 
 using namespace wallpaper;
@@ -9,54 +9,64 @@ using namespace wallpaper::fs;
 
 namespace
 {
-std::string ReadSizedString(IBinaryStream& f) {
-    idx ilen = f.ReadInt32();
-    assert(ilen >= 0);
-
-    usize       len = (usize)ilen;
-    std::string result;
-    result.resize(len);
-    f.Read(result.data(), len);
-    return result;
+std::string_view ReadSizedString(BinaryReader& f) {
+    i32 len = f.ReadInt32();
+    if (len < 0) return {};
+    auto str = f.ReadBytes((usize)len);
+    return { (const char*)str.data(), str.size() };
 }
 } // namespace
 
 std::unique_ptr<WPPkgFs> WPPkgFs::CreatePkgFs(std::string_view pkgpath) {
-    auto ppkg = fs::CreateCBinaryStream(pkgpath);
-    if (! ppkg) return nullptr;
+    auto map = MemoryMap::Create(pkgpath);
+    if (! map) return nullptr;
 
-    auto&       pkg = *ppkg;
-    std::string ver = ReadSizedString(pkg);
-    LOG_INFO("pkg version: %s", ver.data());
+    BinaryReader     pkg(map->Data());
+    std::string_view ver = ReadSizedString(pkg);
+    LOG_INFO("pkg version: %.*s", (int)ver.size(), ver.data());
 
     std::vector<PkgFile> pkgfiles;
     i32                  entryCount = pkg.ReadInt32();
-    for (i32 i = 0; i < entryCount; i++) {
-        std::string path   = "/" + ReadSizedString(pkg);
+    for (i32 i = 0; i < entryCount && pkg.ok(); i++) {
+        std::string path   = "/" + std::string(ReadSizedString(pkg));
         idx         offset = pkg.ReadInt32();
         idx         length = pkg.ReadInt32();
         pkgfiles.push_back({ path, offset, length });
     }
+    if (! pkg.ok()) {
+        LOG_ERROR("pkg \"%.*s\" header truncated", (int)pkgpath.size(), pkgpath.data());
+        return nullptr;
+    }
     auto pkgfs       = std::unique_ptr<WPPkgFs>(new WPPkgFs());
     pkgfs->m_pkgPath = pkgpath;
-    idx headerSize   = pkg.Tell();
+    idx headerSize   = (idx)pkg.Tell();
     for (auto& el : pkgfiles) {
         el.offset += headerSize;
+        if (el.offset < 0 || el.length < 0 || el.offset + el.length > (idx)pkg.Size()) {
+            LOG_ERROR("pkg entry \"%s\" out of range", el.path.c_str());
+            continue;
+        }
         pkgfs->m_files.insert({ el.path, el });
     }
+    pkgfs->m_map = std::move(map);
     return pkgfs;
 }
 
-bool WPPkgFs::Contains(std::string_view path) const { return m_files.count(std::string(path)) > 0; }
+bool WPPkgFs::Contains(std::string_view path) const { return m_files.contains(path); }
 
 std::shared_ptr<IBinaryStream> WPPkgFs::Open(std::string_view path) {
-    auto pkg = fs::CreateCBinaryStream(m_pkgPath);
-    if (! pkg) return nullptr;
-    if (Contains(path)) {
-        const auto& file = m_files.at(std::string(path));
-        return std::make_shared<LimitedBinaryStream>(pkg, file.offset, file.length);
-    }
-    return nullptr;
+    auto it = m_files.find(path);
+    if (it == m_files.end()) return nullptr;
+
+    const auto& file = it->second;
+    m_map->WillNeed((usize)file.offset, (usize)file.length);
+    return std::make_shared<SpanBinaryStream>(
+        m_map->Data().subspan((usize)file.offset, (usize)file.length), m_map);
 }
 
 std::shared_ptr<IBinaryStreamW> WPPkgFs::OpenW(std::string_view) { return nullptr; }
+
+bool WPPkgFs::ListFiles(std::vector<std::string>& paths) const {
+    for (const auto& el : m_files) paths.push_back(el.first);
+    return true;
+}
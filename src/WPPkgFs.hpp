@@ -1,7 +1,8 @@
 #pragma once
 
-#include <unordered_map>
+#include "Core/MapSet.hpp"
 #include "Fs/Fs.h"
+#include "Fs/MemoryMap.h"
 
 namespace wallpaper
 {
@@ -19,6 +20,7 @@ public:
     bool                            Contains(std::string_view path) const override;
     std::shared_ptr<IBinaryStream>  Open(std::string_view path) override;
     std::shared_ptr<IBinaryStreamW> OpenW(std::string_view path) override;
+    bool                            ListFiles(std::vector<std::string>&) const override;
 
 private:
     struct PkgFile {
@@ -27,8 +29,9 @@ private:
         idx offset { 0 };
         idx length { 0 };
     };
-    std::string                              m_pkgPath;
-    std::unordered_map<std::string, PkgFile> m_files;
+    std::string                m_pkgPath;
+    std::shared_ptr<MemoryMap> m_map;
+    StringHashMap<PkgFile>     m_files;
 };
 } // namespace fs
 } // namespace wallpaper
@@ -4,6 +4,7 @@
 #include "Utils/String.h"
 #include "Utils/Logging.h"
 #include "Utils/Algorism.h"
+#include "Utils/ThreadPool.hpp"
 #include "Core/Visitors.hpp"
 #include "Core/StringHelper.hpp"
 #include "Core/ArrayHelper.hpp"
@@ -14,6 +15,7 @@
 #include "WPParticleParser.hpp"
 #include "WPSoundParser.hpp"
 #include "WPMdlParser.hpp"
+#include "CacheArchive.hpp"
 
 #include "Particle/WPParticleRawGener.h"
 #include "Particle/ParticleSystem.h"
@@ -35,6 +37,7 @@
 #include <random>
 #include <cmath>
 #include <functional>
+#include <future>
 #include <regex>
 #include <variant>
 #include <Eigen/Dense>
@@ -42,6 +45,9 @@
 using namespace wallpaper;
 using namespace Eigen;
 
+// compacted to the most recently used shaders over this
+constexpr usize SHADER_CACHE_BYTES { 64 * 1024 * 1024 };
+
 std::string getAddr(void* p) { return std::to_string(reinterpret_cast<intptr_t>(p)); }
 
 struct ParseContext {
@@ -50,6 +56,13 @@ struct ParseContext {
     i32                    ortho_w;
     i32                    ortho_h;
     fs::VFS*               vfs;
+    WPTexImageParser*      tex_parser;
+
+    // shader compiles of the parsed materials, joined before FinalGlslang
+    std::vector<std::shared_future<bool>> shader_jobs;
+    WPShaderMemo                          shader_memo;
+    // compiled spirv shared by all scenes, when /cache is mounted
+    std::shared_ptr<CacheArchive> shader_cache;
 
     ShaderValueMap             global_base_uniforms;
     std::shared_ptr<SceneNode> effect_camera_node;
@@ -246,11 +259,13 @@ void ParseSpecTexName(std::string& name, const wpscene::WPMaterial& wpmat,
     }
 }
 
-bool LoadMaterial(fs::VFS& vfs, const wpscene::WPMaterial& wpmat, Scene* pScene, SceneNode* pNode,
-                  SceneMaterial* pMaterial, WPShaderValueData* pSvData,
+bool LoadMaterial(ParseContext& context, const wpscene::WPMaterial& wpmat, Scene* pScene,
+                  SceneNode* pNode, SceneMaterial* pMaterial, WPShaderValueData* pSvData,
                   WPShaderInfo* pWPShaderInfo = nullptr) {
     (void)pNode;
 
+    auto& vfs = *context.vfs;
+
     auto& svData   = *pSvData;
     auto& material = *pMaterial;
 
@@ -302,7 +317,8 @@ bool LoadMaterial(fs::VFS& vfs, const wpscene::WPMaterial& wpmat, Scene* pScene,
     }
 
     for (auto& unit : sd_units) {
-        unit.src = WPShaderParser::PreShaderSrc(vfs, unit.src, pWPShaderInfo, texinfos);
+        unit.src = WPShaderParser::PreShaderSrc(
+            vfs, unit.src, pWPShaderInfo, texinfos, &context.shader_memo);
     }
 
     shader->default_uniforms = pWPShaderInfo->svs;
@@ -398,10 +414,13 @@ bool LoadMaterial(fs::VFS& vfs, const wpscene::WPMaterial& wpmat, Scene* pScene,
         // pWPShaderInfo->combos.at("LIGHTING");
     }
 
-    if (! WPShaderParser::CompileToSpv(
-            pScene->scene_id, sd_units, shader->codes, vfs, pWPShaderInfo, texinfos)) {
-        return false;
-    }
+    // a failed compile leaves the codes empty, the pass is skipped by the renderer
+    context.shader_jobs.push_back(WPShaderParser::CompileToSpv(sd_units,
+                                                               shader,
+                                                               context.shader_cache.get(),
+                                                               pWPShaderInfo,
+                                                               texinfos,
+                                                               &context.shader_memo));
 
     material.blenmode = ParseBlendMode(wpmat.blending);
 
@@ -497,11 +516,16 @@ void ParseCamera(ParseContext& context, wpscene::WPSceneGeneral& general) {
     scene.sceneGraph->AppendChild(context.global_perspective_camera_node);
 }
 
-void InitContext(ParseContext& context, fs::VFS& vfs, wpscene::WPScene& sc) {
+void InitContext(ParseContext& context, fs::VFS& vfs, wpscene::WPScene& sc,
+                 std::string_view scene_id, std::string_view pkg_id, std::string_view cache_path) {
     context.scene            = std::make_shared<Scene>();
     context.vfs              = &vfs;
     auto& scene              = *context.scene;
-    scene.imageParser        = std::make_unique<WPTexImageParser>(&vfs);
+    auto  tex_parser         = std::make_unique<WPTexImageParser>(&vfs, scene_id, pkg_id);
+    context.tex_parser       = tex_parser.get();
+    scene.imageParser        = std::move(tex_parser);
+    if (vfs.IsMounted("cache") && ! cache_path.empty())
+        context.shader_cache = CacheArchive::Shared(cache_path, "shaders", SHADER_CACHE_BYTES);
     scene.paritileSys->gener = std::make_unique<WPParticleRawGener>();
     scene.shaderValueUpdater = std::make_unique<WPShaderValueUpdater>(&scene);
     GenCardMesh(scene.default_effect_mesh, { 2, 2 });
@@ -618,7 +642,7 @@ void ParseImageObj(ParseContext& context, wpscene::WPImageObject& img_obj) {
 
         shaderInfo.baseConstSvs = baseConstSvs;
 
-        if (! LoadMaterial(vfs,
+        if (! LoadMaterial(context,
                            wpimgobj.material,
                            context.scene.get(),
                            spImgNode.get(),
@@ -851,7 +875,7 @@ void ParseImageObj(ParseContext& context, wpscene::WPImageObject& img_obj) {
                     ShaderValue::fromMatrix(Eigen::Matrix4f::Identity());
                 SceneMaterial     material;
                 WPShaderValueData svData;
-                if (! LoadMaterial(vfs,
+                if (! LoadMaterial(context,
                                    wpmat,
                                    context.scene.get(),
                                    spEffNode.get(),
@@ -985,7 +1009,7 @@ void ParseParticleObj(ParseContext& context, wpscene::WPParticleObject& wppartob
         shaderInfo.combos["SPRITESHEETBLEND"] = "1";
     }
 
-    if (! LoadMaterial(vfs,
+    if (! LoadMaterial(context,
                        particle_obj.material,
                        context.scene.get(),
                        spNode.get(),
@@ -1091,8 +1115,9 @@ void AddWPObject(std::vector<WPObjectVar>& objs, const nlohmann::json& json_obj,
 }
 } // namespace
 
-std::shared_ptr<Scene> WPSceneParser::Parse(std::string_view scene_id, const std::string& buf,
-                                            fs::VFS& vfs, audio::SoundManager& sm) {
+std::shared_ptr<Scene> WPSceneParser::Parse(std::string_view scene_id, std::string_view pkg_id,
+                                            const std::string& buf, fs::VFS& vfs,
+                                            audio::SoundManager& sm) {
     nlohmann::json json;
     if (! PARSE_JSON(buf, json)) return nullptr;
     wpscene::WPScene sc;
@@ -1130,7 +1155,7 @@ std::shared_ptr<Scene> WPSceneParser::Parse(std::string_view scene_id, const std
         sc.general.orthogonalprojection.height = h;
     }
 
-    InitContext(context, vfs, sc);
+    InitContext(context, vfs, sc, scene_id, pkg_id, m_cache_path);
     ParseCamera(context, sc.general);
 
     {
@@ -1169,6 +1194,11 @@ std::shared_ptr<Scene> WPSceneParser::Parse(std::string_view scene_id, const std
                    obj);
     }
 
+    for (auto& job : context.shader_jobs) utils::ThreadPool::Global().Wait(job);
+    context.shader_jobs.clear();
     WPShaderParser::FinalGlslang();
+    if (context.shader_cache) context.shader_cache->Commit();
+    // headers of all textures were scanned by now
+    context.tex_parser->SaveIndex();
     return context.scene;
 }
@@ -9,6 +9,13 @@ class WPSceneParser : public ISceneParser {
 public:
     WPSceneParser()  = default;
     ~WPSceneParser() = default;
-    std::shared_ptr<Scene> Parse(std::string_view scene_id, const std::string&, fs::VFS&, audio::SoundManager&) override;
+    std::shared_ptr<Scene> Parse(std::string_view scene_id, std::string_view pkg_id, const std::string&,
+                                 fs::VFS&, audio::SoundManager&) override;
+
+    // physical folder mounted as /cache, for the archives shared by all scenes
+    void SetCachePath(std::string_view path) { m_cache_path = path; }
+
+private:
+    std::string m_cache_path;
 };
 } // namespace wallpaper
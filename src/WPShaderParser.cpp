@@ -7,10 +7,15 @@
 #include "wpscene/WPUniform.h"
 #include "Fs/VFS.h"
 #include "Utils/Sha.hpp"
+#include "Utils/ContentStore.hpp"
 #include "Utils/String.h"
+#include "Utils/ThreadPool.hpp"
 #include "WPCommon.hpp"
+#include "CacheArchive.hpp"
+#include "Fs/MemBinaryStream.h"
 
 #include "Vulkan/ShaderComp.hpp"
+#include "Vulkan/Shader.hpp"
 
 #include <regex>
 #include <stack>
@@ -19,9 +24,6 @@
 
 static constexpr std::string_view SHADER_PLACEHOLD { "__SHADER_PLACEHOLD__" };
 
-#define SHADER_DIR    "spvs01"
-#define SHADER_SUFFIX "spvs"
-
 using namespace wallpaper;
 
 namespace
@@ -366,13 +368,24 @@ inline std::string GenSha1(std::span<const WPShaderUnit> units) {
     }
     return utils::genSha1(shas);
 }
-inline std::string GetCachePath(std::string_view scene_id, std::string_view filename) {
-    return std::string("/cache/") + std::string(scene_id) + "/" SHADER_DIR "/" +
-           std::string(filename) + "." SHADER_SUFFIX;
-}
 
-inline bool LoadShaderFromFile(std::vector<ShaderCode>& codes, fs::IBinaryStream& file) {
+struct CompiledShader {
+    std::vector<ShaderCode> codes;
+    // vulkan::SaveReflect of the codes, empty if not known
+    std::vector<uint8_t> reflection;
+};
+
+/*
+    SPVS0002
+    u32 code count
+        code: u32 size, spirv
+    u32 reflection size, reflection, not in SPVS0001
+    256 zero bytes
+*/
+inline bool LoadShaderFromFile(CompiledShader& compiled, fs::IBinaryStream& file) {
+    auto& codes = compiled.codes;
     codes.clear();
+    compiled.reflection.clear();
     i32 ver = ReadSPVVesion(file);
 
     usize count = file.ReadUint32();
@@ -390,27 +403,33 @@ inline bool LoadShaderFromFile(std::vector<ShaderCode>& codes, fs::IBinaryStream
         c.resize(size / 4);
         file.Read((char*)c.data(), size);
     }
+    if (ver >= 2) {
+        u32 size = file.ReadUint32();
+        if ((isize)size > file.Size() - file.Tell()) return false;
+        compiled.reflection.resize(size);
+        file.Read((char*)compiled.reflection.data(), size);
+    }
     return true;
 }
 
-inline void SaveShaderToFile(std::span<const ShaderCode> codes, fs::IBinaryStreamW& file) {
+inline void SaveShaderToFile(const CompiledShader& compiled, fs::IBinaryStreamW& file) {
     char nop[256] { '\0' };
 
-    WriteSPVVesion(file, 1);
-    file.WriteUint32((u32)codes.size());
-    for (const auto& c : codes) {
+    WriteSPVVesion(file, 2);
+    file.WriteUint32((u32)compiled.codes.size());
+    for (const auto& c : compiled.codes) {
         u32 size = (u32)c.size() * 4;
         file.WriteUint32(size);
         file.Write((const char*)c.data(), size);
     }
+    file.WriteUint32((u32)compiled.reflection.size());
+    file.Write((const char*)compiled.reflection.data(), compiled.reflection.size());
     file.Write(nop, sizeof(nop));
 }
 
-} // namespace
-
-std::string WPShaderParser::PreShaderSrc(fs::VFS& vfs, const std::string& src,
-                                         WPShaderInfo*                       pWPShaderInfo,
-                                         const std::vector<WPShaderTexInfo>& texinfos) {
+// include expansion and annotations, the annotations are added to an empty info
+std::string ExpandShaderSrc(fs::VFS& vfs, const std::string& src, WPShaderInfo* pWPShaderInfo,
+                            const std::vector<WPShaderTexInfo>& texinfos) {
     std::string            newsrc(src);
     std::string::size_type pos = 0;
     std::string            include;
@@ -429,6 +448,54 @@ std::string WPShaderParser::PreShaderSrc(fs::VFS& vfs, const std::string& src,
     return newsrc;
 }
 
+void AddShaderInfo(WPShaderInfo& info, const WPShaderInfo& added) {
+    for (const auto& [k, v] : added.combos) info.combos[k] = v;
+    for (const auto& [k, v] : added.svs) info.svs[k] = v;
+    for (const auto& [k, v] : added.alias) info.alias[k] = v;
+    info.defTexs.insert(info.defTexs.end(), added.defTexs.begin(), added.defTexs.end());
+}
+
+std::string SourceMemoKey(const std::string& src, std::span<const WPShaderTexInfo> texinfos) {
+    std::string key(src);
+    key.push_back('\0');
+    for (const auto& t : texinfos) {
+        key.push_back((char)('0' + t.enabled));
+        for (bool c : t.composEnabled) key.push_back((char)('0' + c));
+    }
+    return utils::genSha1(key);
+}
+
+// preprocessed source depends on the combos too
+std::string BuildMemoKey(std::span<const WPShaderUnit> units, const Combos& combos) {
+    std::string key;
+    for (const auto& unit : units) key.append(utils::genSha1(unit.src)).push_back('\n');
+    for (const auto& [k, v] : combos) key.append(k).append("=").append(v).push_back('\n');
+    return utils::genSha1(key);
+}
+
+} // namespace
+
+std::string WPShaderParser::PreShaderSrc(fs::VFS& vfs, const std::string& src,
+                                         WPShaderInfo*                       pWPShaderInfo,
+                                         const std::vector<WPShaderTexInfo>& texinfos,
+                                         WPShaderMemo*                       memo) {
+    std::string memo_key;
+    if (memo != nullptr) {
+        memo_key = SourceMemoKey(src, texinfos);
+        if (auto it = memo->sources.find(memo_key); it != memo->sources.end()) {
+            AddShaderInfo(*pWPShaderInfo, it->second.added);
+            return it->second.src;
+        }
+    }
+
+    // ParseWPShader only assigns, so what it adds can be replayed from the memo
+    WPShaderMemo::Source source;
+    source.src = ExpandShaderSrc(vfs, src, &source.added, texinfos);
+    AddShaderInfo(*pWPShaderInfo, source.added);
+    if (memo == nullptr) return std::move(source.src);
+    return memo->sources.emplace(std::move(memo_key), std::move(source)).first->second.src;
+}
+
 std::string WPShaderParser::PreShaderHeader(const std::string& src, const Combos& combos,
                                             ShaderType type) {
     std::string pre(pre_shader_code);
@@ -450,16 +517,49 @@ std::string WPShaderParser::PreShaderHeader(const std::string& src, const Combos
 void WPShaderParser::InitGlslang() { glslang::InitializeProcess(); }
 void WPShaderParser::FinalGlslang() { glslang::FinalizeProcess(); }
 
-bool WPShaderParser::CompileToSpv(std::string_view scene_id, std::span<WPShaderUnit> units,
-                                  std::vector<ShaderCode>& codes, fs::VFS& vfs,
-                                  WPShaderInfo* shader_info, std::span<const WPShaderTexInfo> texs) {
+std::shared_future<bool> WPShaderParser::CompileToSpv(std::span<WPShaderUnit>       units,
+                                                      std::shared_ptr<SceneShader>& shader,
+                                                      CacheArchive*                 cache,
+                                                      WPShaderInfo*                 shader_info,
+                                                      std::span<const WPShaderTexInfo> texs,
+                                                      WPShaderMemo*                    memo) {
     (void)texs;
 
+    std::string memo_key;
+    if (memo != nullptr) {
+        memo_key = BuildMemoKey(units, shader_info->combos);
+        if (auto it = memo->builds.find(memo_key); it != memo->builds.end()) {
+            auto& build = it->second;
+            for (usize i = 0; i < units.size() && i < build.preprocess_infos.size(); i++)
+                units[i].preprocess_info = build.preprocess_infos[i];
+            shader = build.shader;
+            return build.job;
+        }
+    }
+
     std::for_each(units.begin(), units.end(), [shader_info](auto& unit) {
         unit.src = Preprocessor(unit.src, unit.stage, shader_info->combos, unit.preprocess_info);
     });
 
-    auto compile = [](std::span<WPShaderUnit> units, std::vector<ShaderCode>& codes) {
+    // the job gets its own units, the caller keeps reading preprocess_info
+    std::shared_future<bool> job = utils::ThreadPool::Global().Post(
+        [units = std::vector<WPShaderUnit>(units.begin(), units.end()), shader, cache]() mutable {
+            bool ok = CompileUnits(units, *shader, cache);
+            if (! ok) LOG_ERROR("compile shader '%s' failed", shader->name.c_str());
+            return ok;
+        });
+
+    if (memo != nullptr) {
+        WPShaderMemo::Build build { .preprocess_infos = {}, .shader = shader, .job = job };
+        for (const auto& unit : units) build.preprocess_infos.push_back(unit.preprocess_info);
+        memo->builds.emplace(std::move(memo_key), std::move(build));
+    }
+    return job;
+}
+
+bool WPShaderParser::CompileUnits(std::span<WPShaderUnit> units, SceneShader& shader,
+                                  CacheArchive* cache) {
+    auto compile = [](std::span<WPShaderUnit> units, CompiledShader& compiled) {
         std::vector<vulkan::ShaderCompUnit> vunits(units.size());
         for (usize i = 0; i < units.size(); i++) {
             auto&               unit     = units[i];
@@ -488,34 +588,65 @@ bool WPShaderParser::CompileToSpv(std::string_view scene_id, std::span<WPShaderU
             return false;
         }
 
-        codes.clear();
+        compiled.codes.clear();
         for (auto& spv : spvs) {
-            codes.emplace_back(std::move(spv->spirv));
+            compiled.codes.emplace_back(std::move(spv->spirv));
         }
+
+        // reflected once here, pass preparation loads it with the codes
+        vulkan::ShaderReflected ref;
+        compiled.reflection.clear();
+        if (vulkan::GenReflect(compiled.codes, spvs, ref))
+            compiled.reflection = vulkan::SaveReflect(spvs, ref);
         return true;
     };
 
-    bool has_cache_dir = vfs.IsMounted("cache");
+    auto& store     = utils::ContentStore::Global();
+    bool  use_store = store.Budget() > 0;
 
-    if (has_cache_dir) {
-        std::string sha1            = GenSha1(units);
-        std::string cache_file_path = GetCachePath(scene_id, sha1);
+    std::string sha1;
+    if (cache != nullptr || use_store) sha1 = GenSha1(units);
 
-        if (vfs.Contains(cache_file_path)) {
-            auto cache_file = vfs.Open(cache_file_path);
-            if (! cache_file || ! ::LoadShaderFromFile(codes, *cache_file)) {
-                LOG_ERROR("load shader from \'%s\' failed", cache_file_path.c_str());
-                return false;
-            }
-        } else {
-            if (! compile(units, codes)) return false;
-            if (auto cache_file = vfs.OpenW(cache_file_path); cache_file) {
-                ::SaveShaderToFile(codes, *cache_file);
+    CompiledShader compiled;
+    auto           done = [&]() {
+        shader.codes      = compiled.codes;
+        shader.reflection = compiled.reflection;
+        return true;
+    };
+
+    // compiled by an earlier load, maybe of another wallpaper
+    std::string store_key = "spv:" + sha1;
+    if (use_store) {
+        if (auto shared = store.Get<CompiledShader>(store_key); shared) {
+            compiled = *shared;
+            return done();
+        }
+    }
+    auto store_codes = [&]() {
+        if (! use_store) return;
+        usize size { compiled.reflection.size() };
+        for (const auto& c : compiled.codes) size += c.size() * sizeof(c[0]);
+        store.Put<CompiledShader>(store_key, std::make_shared<CompiledShader>(compiled), size);
+    };
+
+    if (cache != nullptr) {
+        if (auto cache_file = cache->Get(sha1); cache_file) {
+            if (::LoadShaderFromFile(compiled, *cache_file)) {
+                store_codes();
+                return done();
             }
+            LOG_ERROR("load shader \'%s\' from cache failed", sha1.c_str());
         }
-        return true;
+        if (! compile(units, compiled)) return false;
+        fs::MemBinaryStreamW cache_file;
+        ::SaveShaderToFile(compiled, cache_file);
+        cache->Put(sha1, cache_file.Data());
+        store_codes();
+        return done();
 
     } else {
-        return compile(units, codes);
+        if (! compile(units, compiled)) return false;
+        store_codes();
+        return done();
     }
 }
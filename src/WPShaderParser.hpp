@@ -1,9 +1,12 @@
 #pragma once
 
+#include <future>
+#include <memory>
 #include <span>
 #include "Scene/Scene.h"
 #include "Scene/SceneShader.h"
 #include "Type.hpp"
+#include "Core/MapSet.hpp"
 
 namespace wallpaper
 {
@@ -11,6 +14,8 @@ namespace fs
 {
 class VFS;
 }
+class CacheArchive;
+
 using Combos = Map<std::string, std::string>;
 
 // ui material name to gl uniform name
@@ -44,18 +49,46 @@ struct WPShaderUnit {
     WPPreprocessorInfo preprocess_info;
 };
 
+// shaders built during one scene parse, the same effect on many layers is built once
+// only used on the parse thread
+struct WPShaderMemo {
+    // PreShaderSrc result and what it adds to the shader info, by raw source and tex infos
+    struct Source {
+        std::string  src;
+        WPShaderInfo added;
+    };
+    // by source and combos
+    struct Build {
+        std::vector<WPPreprocessorInfo> preprocess_infos;
+        std::shared_ptr<SceneShader>    shader;
+        std::shared_future<bool>        job;
+    };
+    StringHashMap<Source> sources;
+    StringHashMap<Build>  builds;
+};
+
 class WPShaderParser {
 public:
     static std::string PreShaderSrc(fs::VFS&, const std::string& src, WPShaderInfo* pWPShaderInfo,
-                                    const std::vector<WPShaderTexInfo>& texs);
+                                    const std::vector<WPShaderTexInfo>& texs,
+                                    WPShaderMemo*                       memo = nullptr);
 
     static std::string PreShaderHeader(const std::string& src, const Combos& combos, ShaderType);
 
     static void InitGlslang();
     static void FinalGlslang();
 
-    static bool CompileToSpv(std::string_view         scene_id, std::span<WPShaderUnit>,
-                             std::vector<ShaderCode>& spvs, fs::VFS&, WPShaderInfo*,
-                             std::span<const WPShaderTexInfo>);
+    // units are preprocessed before this returns, their preprocess_info is ready
+    // glslang runs on the worker pool and fills shader->codes, wait the future before
+    // FinalGlslang
+    // with a memo, shader is replaced by the one already built from the same source
+    // compiled spirv is looked up in and added to cache if not null, Commit is left to the caller
+    static std::shared_future<bool> CompileToSpv(std::span<WPShaderUnit>,
+                                                 std::shared_ptr<SceneShader>& shader, CacheArchive*,
+                                                 WPShaderInfo*, std::span<const WPShaderTexInfo>,
+                                                 WPShaderMemo* memo = nullptr);
+
+private:
+    static bool CompileUnits(std::span<WPShaderUnit>, SceneShader&, CacheArchive*);
 };
 } // namespace wallpaper
@@ -53,29 +53,29 @@ void WPShaderValueUpdater::MouseInput(double x, double y) {
 void WPShaderValueUpdater::InitUniforms(SceneNode* pNode, const ExistsUniformOp& existsOp) {
     m_nodeUniformInfoMap[pNode] = WPUniformInfo();
     auto& info                  = m_nodeUniformInfoMap[pNode];
-    info.has_MI                 = existsOp(G_MI);
-    info.has_M                  = existsOp(G_M);
-    info.has_AM                 = existsOp(G_AM);
-    info.has_MVP                = existsOp(G_MVP);
-    info.has_MVPI               = existsOp(G_MVPI);
-    info.has_ETVP               = existsOp(G_ETVP);
-    info.has_ETVPI              = existsOp(G_ETVPI);
-
-    info.has_VP = existsOp(G_VP);
-
-    info.has_BONES            = existsOp(G_BONES);
-    info.has_TIME             = existsOp(G_TIME);
-    info.has_DAYTIME          = existsOp(G_DAYTIME);
-    info.has_POINTERPOSITION  = existsOp(G_POINTERPOSITION);
-    info.has_PARALLAXPOSITION = existsOp(G_PARALLAXPOSITION);
-    info.has_TEXELSIZE        = existsOp(G_TEXELSIZE);
-    info.has_TEXELSIZEHALF    = existsOp(G_TEXELSIZEHALF);
-    info.has_SCREEN           = existsOp(G_SCREEN);
-    info.has_LP               = existsOp(G_LP);
+    info.has_MI                 = existsOp(UniformId::MI);
+    info.has_M                  = existsOp(UniformId::M);
+    info.has_AM                 = existsOp(UniformId::AM);
+    info.has_MVP                = existsOp(UniformId::MVP);
+    info.has_MVPI               = existsOp(UniformId::MVPI);
+    info.has_ETVP               = existsOp(UniformId::ETVP);
+    info.has_ETVPI              = existsOp(UniformId::ETVPI);
+
+    info.has_VP = existsOp(UniformId::VP);
+
+    info.has_BONES            = existsOp(UniformId::BONES);
+    info.has_TIME             = existsOp(UniformId::TIME);
+    info.has_DAYTIME          = existsOp(UniformId::DAYTIME);
+    info.has_POINTERPOSITION  = existsOp(UniformId::POINTERPOSITION);
+    info.has_PARALLAXPOSITION = existsOp(UniformId::PARALLAXPOSITION);
+    info.has_TEXELSIZE        = existsOp(UniformId::TEXELSIZE);
+    info.has_TEXELSIZEHALF    = existsOp(UniformId::TEXELSIZEHALF);
+    info.has_SCREEN           = existsOp(UniformId::SCREEN);
+    info.has_LP               = existsOp(UniformId::LP);
 
     std::accumulate(begin(info.texs), end(info.texs), 0, [&existsOp](uint index, auto& value) {
-        value.has_resolution = existsOp(WE_GLTEX_RESOLUTION_NAMES[index]);
-        value.has_mipmap     = existsOp(WE_GLTEX_MIPMAPINFO_NAMES[index]);
+        value.has_resolution = existsOp(TexUniform(UniformId::TEX_RESOLUTION, index));
+        value.has_mipmap     = existsOp(TexUniform(UniformId::TEX_MIPMAPINFO, index));
         return index + 1;
     });
 }
@@ -114,16 +114,16 @@ void WPShaderValueUpdater::UpdateUniforms(SceneNode* pNode, sprite_map_t& sprite
 
             if (unifrom_tex.has_resolution) {
                 std::array<i32, 4> resolution_uint({ rt.width, rt.height, rt.width, rt.height });
-                updateOp(WE_GLTEX_RESOLUTION_NAMES[el.first],
+                updateOp(TexUniform(UniformId::TEX_RESOLUTION, el.first),
                          ShaderValue(array_cast<float>(resolution_uint)));
             }
             if (unifrom_tex.has_mipmap) {
-                updateOp(WE_GLTEX_MIPMAPINFO_NAMES[el.first], (float)rt.mipmap_level);
+                updateOp(TexUniform(UniformId::TEX_MIPMAPINFO, el.first), (float)rt.mipmap_level);
             }
         }
         if (nodeData.puppet_layer.hasPuppet() && info.has_BONES) {
             auto data = nodeData.puppet_layer.genFrame(m_scene->frameTime);
-            updateOp(G_BONES, std::span<const float> { data[0].data(), data.size() * 16 });
+            updateOp(UniformId::BONES, std::span<const float> { data[0].data(), data.size() * 16 });
         }
     }
 
@@ -138,7 +138,7 @@ void WPShaderValueUpdater::UpdateUniforms(SceneNode* pNode, sprite_map_t& sprite
     Matrix4d viewProTrans = camera->GetViewProjectionMatrix();
 
     if (info.has_VP) {
-        updateOp(G_VP, ShaderValue::fromMatrix(viewProTrans));
+        updateOp(UniformId::VP, ShaderValue::fromMatrix(viewProTrans));
     }
     if (reqM || reqMVP || reqMI || reqMVPI) {
         Matrix4d modelTrans = pNode->ModelTrans();
@@ -162,13 +162,13 @@ void WPShaderValueUpdater::UpdateUniforms(SceneNode* pNode, sprite_map_t& sprite
             }
         }
 
-        if (reqM) updateOp(G_M, ShaderValue::fromMatrix(modelTrans));
-        if (reqAM) updateOp(G_AM, ShaderValue::fromMatrix(modelTrans));
-        if (reqMI) updateOp(G_MI, ShaderValue::fromMatrix(modelTrans.inverse()));
+        if (reqM) updateOp(UniformId::M, ShaderValue::fromMatrix(modelTrans));
+        if (reqAM) updateOp(UniformId::AM, ShaderValue::fromMatrix(modelTrans));
+        if (reqMI) updateOp(UniformId::MI, ShaderValue::fromMatrix(modelTrans.inverse()));
         if (reqMVP) {
             Matrix4d mvpTrans = viewProTrans * modelTrans;
-            updateOp(G_MVP, ShaderValue::fromMatrix(mvpTrans));
-            if (reqMVPI) updateOp(G_MVPI, ShaderValue::fromMatrix(mvpTrans.inverse()));
+            updateOp(UniformId::MVP, ShaderValue::fromMatrix(mvpTrans));
+            if (reqMVPI) updateOp(UniformId::MVPI, ShaderValue::fromMatrix(mvpTrans.inverse()));
         }
         if (reqETVP || reqETVPI) {
             /*
@@ -176,8 +176,8 @@ void WPShaderValueUpdater::UpdateUniforms(SceneNode* pNode, sprite_map_t& sprite
             nodePos.z()      = 1.0f;
             Matrix4d etvpTrans =
                 viewProTrans * modelTrans * Affine3d(Eigen::Scaling(nodePos)).matrix();
-            if (reqETVPI) updateOp(G_ETVP, ShaderValue::fromMatrix(etvpTrans));
-            if (reqETVPI) updateOp(G_ETVPI, ShaderValue::fromMatrix(etvpTrans.inverse()));
+            if (reqETVPI) updateOp(UniformId::ETVP, ShaderValue::fromMatrix(etvpTrans));
+            if (reqETVPI) updateOp(UniformId::ETVPI, ShaderValue::fromMatrix(etvpTrans.inverse()));
             */
         }
     }
@@ -185,19 +185,20 @@ void WPShaderValueUpdater::UpdateUniforms(SceneNode* pNode, sprite_map_t& sprite
     //	g_EffectTextureProjectionMatrix
     // shadervs.push_back({"g_EffectTextureProjectionMatrixInverse",
     // ShaderValue::ValueOf(Eigen::Matrix4f::Identity())});
-    if (info.has_TIME) updateOp(G_TIME, (float)m_scene->elapsingTime);
+    if (info.has_TIME) updateOp(UniformId::TIME, (float)m_scene->elapsingTime);
 
-    if (info.has_DAYTIME) updateOp(G_DAYTIME, (float)m_dayTime);
+    if (info.has_DAYTIME) updateOp(UniformId::DAYTIME, (float)m_dayTime);
 
-    if (info.has_POINTERPOSITION) updateOp(G_POINTERPOSITION, m_mousePos);
+    if (info.has_POINTERPOSITION) updateOp(UniformId::POINTERPOSITION, m_mousePos);
 
-    if (info.has_TEXELSIZE) updateOp(G_TEXELSIZE, m_texelSize);
+    if (info.has_TEXELSIZE) updateOp(UniformId::TEXELSIZE, m_texelSize);
 
     if (info.has_TEXELSIZEHALF)
-        updateOp(G_TEXELSIZEHALF, std::array { m_texelSize[0] / 2.0f, m_texelSize[1] / 2.0f });
+        updateOp(UniformId::TEXELSIZEHALF,
+                 std::array { m_texelSize[0] / 2.0f, m_texelSize[1] / 2.0f });
 
     if (info.has_SCREEN)
-        updateOp(G_SCREEN,
+        updateOp(UniformId::SCREEN,
                  std::array<float, 3> {
                      m_screen_size[0], m_screen_size[1], m_screen_size[0] / m_screen_size[1] });
 
@@ -206,13 +207,13 @@ void WPShaderValueUpdater::UpdateUniforms(SceneNode* pNode, sprite_map_t& sprite
             Vector2f { 0.5f, 0.5f } +
             (Scaling(1.0f, -1.0f) * (Vector2f(&m_mousePos[0])) - Vector2f { 0.5f, 0.5f }) *
                 m_parallax.mouseinfluence;
-        updateOp(G_PARALLAXPOSITION, std::array { para[0], para[1] });
+        updateOp(UniformId::PARALLAXPOSITION, std::array { para[0], para[1] });
     }
 
     for (auto& [i, sp] : sprites) {
         const auto& f      = sp.GetAnimateFrame(m_scene->frameTime);
-        auto        grot   = WE_GLTEX_ROTATION_NAMES[i];
-        auto        gtrans = WE_GLTEX_TRANSLATION_NAMES[i];
+        auto        grot   = TexUniform(UniformId::TEX_ROTATION, i);
+        auto        gtrans = TexUniform(UniformId::TEX_TRANSLATION, i);
         updateOp(grot, std::array { f.xAxis[0], f.xAxis[1], f.yAxis[0], f.yAxis[1] });
         updateOp(gtrans, std::array { f.x, f.y });
     }
@@ -232,8 +233,8 @@ void WPShaderValueUpdater::UpdateUniforms(SceneNode* pNode, sprite_map_t& sprite
             }
             i++;
         }
-        updateOp(G_LP, lights);
-        updateOp(G_LCP, lights_color);
+        updateOp(UniformId::LP, lights);
+        updateOp(UniformId::LCP, lights_color);
     }
 }
 
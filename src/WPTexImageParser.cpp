@@ -8,13 +8,25 @@
 #include "SpriteAnimation.hpp"
 #include "Utils/Algorism.h"
 #include "Fs/VFS.h"
+#include "Fs/BinaryReader.h"
 #include "Utils/BitFlags.hpp"
+#include "Utils/Sha.hpp"
+#include "Utils/BcEncoder.hpp"
+#include "Utils/ContentStore.hpp"
+#include "Utils/ThreadPool.hpp"
+#include "Utils/Trace.h"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
+#include <bit>
 #include <cstring>
 #include <iostream>
+#include <limits>
+
+#define TEX_CACHE_DIR    "texc01"
+#define TEX_CACHE_SUFFIX "texc"
+#define TEX_INDEX_FILE   "texindex"
 
 using namespace wallpaper;
 
@@ -32,14 +44,40 @@ enum class WPTexFlagEnum : uint32_t
 };
 using WPTexFlags = BitFlags<WPTexFlagEnum>;
 
+struct wallpaper::WPTexIndex {
+    struct Mipmap {
+        i32  width { 0 };
+        i32  height { 0 };
+        bool lz4 { false };
+        i32  decompressed_size { 0 };
+        i32  src_size { 0 };
+        // of the payload in the tex
+        u32 offset { 0 };
+    };
+    ImageHeader header;
+    u32         file_size { 0 };
+    // bytes before the mipmap table
+    u32 header_size { 0 };
+    // sha1 of the header bytes, with file_size identifies the scanned tex
+    std::string header_sha;
+    // false if the mipmap table is broken, only the header is usable
+    bool complete { false };
+
+    std::vector<std::vector<Mipmap>> slots;
+};
+
 namespace
 {
-char* Lz4Decompress(const char* src, int size, int decompressed_size) {
-    char* dst       = new char[(usize)decompressed_size];
-    int   load_size = LZ4_decompress_safe(src, dst, size, decompressed_size);
+ImageDataPtr NewImageData(usize size) {
+    return ImageDataPtr(new uint8_t[size], [](uint8_t* data) {
+        delete[] data;
+    });
+}
+
+ImageDataPtr Lz4Decompress(const char* src, int size, ImageDataPtr dst, int decompressed_size) {
+    int load_size = LZ4_decompress_safe(src, (char*)dst.get(), size, decompressed_size);
     if (load_size < decompressed_size) {
         LOG_ERROR("lz4 decompress failed");
-        delete[] dst;
         return nullptr;
     }
     return dst;
@@ -67,7 +105,7 @@ TextureFormat ToTexFormate(int type) {
         return TextureFormat::RGBA8;
     }
 }
-void LoadHeader(fs::IBinaryStream& file, ImageHeader& header) {
+void LoadHeader(fs::BinaryReader& file, ImageHeader& header) {
     header.extraHeader["texv"].val = ReadTexVesion(file);
     header.extraHeader["texi"].val = ReadTexVesion(file);
 
@@ -118,6 +156,548 @@ void SetHeaderPow2(ImageHeader& header, i32 mip_0_w, i32 mip_0_h) {
     header.mipmap_larger = mip_0_w * mip_0_h > header.mapWidth * header.mapHeight;
 }
 
+/*
+    decoded image cache, mip data is stored as uploaded
+    TEXC0001
+    u32 file size
+    i32 format, slot count, format is bc1/bc3 if transcoded from rgba8
+    slot: i32 width, height, mipmap count
+        mipmap: i32 width, height, u32 size, offset
+    data, each mipmap aligned to TEX_CACHE_ALIGN
+*/
+constexpr usize TEX_CACHE_ALIGN { 16 };
+
+inline usize AlignCache(usize x) { return (x + TEX_CACHE_ALIGN - 1) / TEX_CACHE_ALIGN * TEX_CACHE_ALIGN; }
+
+std::string GetCachePath(std::string_view scene_id, std::string_view filename) {
+    return std::string("/cache/") + std::string(scene_id) + "/" TEX_CACHE_DIR "/" +
+           std::string(filename) + "." TEX_CACHE_SUFFIX;
+}
+
+// pkg, tex path, decode options and the header bytes (format, flags, extents)
+std::string GenCacheKey(std::string_view pkg_id, std::string_view path, std::string_view options,
+                        usize file_size, std::span<const std::byte> header) {
+    std::string key;
+    key.append(pkg_id).append("\n").append(path).append("\n");
+    key.append(std::to_string(file_size)).append("\n");
+    key.append(options).append("\n");
+    key.append((const char*)header.data(), header.size());
+    return utils::genSha1(key);
+}
+
+// allow_bc: rgba8 tex may be cached as bc1/bc3
+bool LoadCachedImage(fs::VFS& vfs, const std::string& path, Image& img, bool allow_bc = false) {
+    auto pfile = vfs.OpenMapped(path);
+    if (! pfile || pfile->Data().empty()) return false;
+    fs::BinaryReader file(pfile->Data());
+
+    if (ReadTexCacheVesion(file) != 1 || file.ReadUint32() != file.Size()) {
+        LOG_ERROR("texture cache \"%s\" is broken", path.c_str());
+        return false;
+    }
+    auto format = (TextureFormat)file.ReadInt32();
+    bool bc     = format == TextureFormat::BC1 || format == TextureFormat::BC3;
+    if (format != img.header.format && ! (allow_bc && bc)) return false;
+    if (file.ReadInt32() != img.header.count) return false;
+
+    img.slots.resize((usize)img.header.count);
+    for (auto& slot : img.slots) {
+        slot.width       = file.ReadInt32();
+        slot.height      = file.ReadInt32();
+        i32 mipmap_count = file.ReadInt32();
+        if (mipmap_count <= 0 || ! file.ok()) return false;
+        slot.mipmaps.resize((usize)mipmap_count);
+        for (auto& mipmap : slot.mipmaps) {
+            mipmap.width  = file.ReadInt32();
+            mipmap.height = file.ReadInt32();
+            usize size    = file.ReadUint32();
+            usize offset  = file.ReadUint32();
+            if (! file.ok() || offset > file.Size() || size > file.Size() - offset) return false;
+
+            // read only view into the mapping, the deleter keeps it alive
+            auto* data  = (uint8_t*)(file.Data().data() + offset);
+            mipmap.data = ImageDataPtr(data, [pfile](uint8_t*) {
+            });
+            mipmap.size = (isize)size;
+        }
+    }
+    for (const auto& slot : img.slots) {
+        SetHeaderPow2(img.header, slot.mipmaps[0].width, slot.mipmaps[0].height);
+    }
+    if (! file.ok()) return false;
+    img.header.format                     = format;
+    img.header.extraHeader["decoded"].val = 1;
+    return true;
+}
+
+usize CacheTableSize(const Image& img) {
+    usize table_size = 9 + 4 * 3;
+    for (const auto& slot : img.slots) table_size += 4 * 3 + slot.mipmaps.size() * 4 * 4;
+    return table_size;
+}
+
+usize CachedImageSize(const Image& img) {
+    usize total = AlignCache(CacheTableSize(img));
+    for (const auto& slot : img.slots)
+        for (const auto& mipmap : slot.mipmaps) total = AlignCache(total + (usize)mipmap.size);
+    return total;
+}
+
+bool SaveCachedImage(fs::IBinaryStreamW& file, const Image& img) {
+    usize table_size = CacheTableSize(img);
+    usize total      = CachedImageSize(img);
+    if (total > std::numeric_limits<u32>::max()) return false;
+
+    WriteTexCacheVesion(file, 1);
+    file.WriteUint32((u32)total);
+    file.WriteInt32((i32)img.header.format);
+    file.WriteInt32((i32)img.slots.size());
+
+    usize offset = AlignCache(table_size);
+    for (const auto& slot : img.slots) {
+        file.WriteInt32(slot.width);
+        file.WriteInt32(slot.height);
+        file.WriteInt32((i32)slot.mipmaps.size());
+        for (const auto& mipmap : slot.mipmaps) {
+            file.WriteInt32(mipmap.width);
+            file.WriteInt32(mipmap.height);
+            file.WriteUint32((u32)mipmap.size);
+            file.WriteUint32((u32)offset);
+            offset = AlignCache(offset + (usize)mipmap.size);
+        }
+    }
+
+    char  pad[TEX_CACHE_ALIGN] { '\0' };
+    usize pos = table_size;
+    file.Write(pad, AlignCache(pos) - pos);
+    pos = AlignCache(pos);
+    for (const auto& slot : img.slots) {
+        for (const auto& mipmap : slot.mipmaps) {
+            file.Write(mipmap.data.get(), (usize)mipmap.size);
+            pos += (usize)mipmap.size;
+            file.Write(pad, AlignCache(pos) - pos);
+            pos = AlignCache(pos);
+        }
+    }
+    return true;
+}
+
+isize ImageDataSize(const Image& img) {
+    isize size { 0 };
+    for (const auto& slot : img.slots)
+        for (const auto& mipmap : slot.mipmaps) size += mipmap.size;
+    return size;
+}
+
+// mipmap data points into the shared image, which is kept alive by the deleters
+void ShareImageData(const std::shared_ptr<const Image>& src, Image& img) {
+    img.slots.resize(src->slots.size());
+    for (usize i = 0; i < img.slots.size(); i++) {
+        const auto& src_slot = src->slots[i];
+        auto&       slot     = img.slots[i];
+        slot.width           = src_slot.width;
+        slot.height          = src_slot.height;
+        slot.mipmaps.resize(src_slot.mipmaps.size());
+        for (usize j = 0; j < slot.mipmaps.size(); j++) {
+            const auto& src_mipmap = src_slot.mipmaps[j];
+            auto&       mipmap     = slot.mipmaps[j];
+            mipmap.width           = src_mipmap.width;
+            mipmap.height          = src_mipmap.height;
+            mipmap.size            = src_mipmap.size;
+            mipmap.data            = ImageDataPtr(src_mipmap.data.get(), [src](uint8_t*) {
+            });
+        }
+        if (! slot.mipmaps.empty())
+            SetHeaderPow2(img.header, slot.mipmaps[0].width, slot.mipmaps[0].height);
+    }
+    img.header.extraHeader["decoded"].val = 1;
+}
+
+struct MipmapJob {
+    ImageData*  mipmap { nullptr };
+    const char* src { nullptr };
+    i32         src_size { 0 };
+    bool        lz4 { false };
+    i32         decompressed_size { 0 };
+    // png, jpg.. decoded to rgba8
+    bool container { false };
+};
+
+// heap if no allocator or it failed
+ImageDataPtr AllocateImageData(IImageDataAllocator* allocator, usize size) {
+    if (allocator != nullptr) {
+        if (auto data = allocator->AllocateImageData(size); data) return data;
+    }
+    return NewImageData(size);
+}
+
+bool DecodeMipmap(const MipmapJob& job, const std::string& path, IImageDataAllocator* allocator) {
+    WP_TRACE_SCOPE("tex decode");
+    auto&        mipmap   = *job.mipmap;
+    const char*  src      = job.src;
+    i32          src_size = job.src_size;
+    ImageDataPtr decompressed;
+    if (job.lz4) {
+        // container bytes are only read by stb, keep them on heap
+        auto* dst_allocator = job.container ? nullptr : allocator;
+        auto  dst           = AllocateImageData(dst_allocator, (usize)job.decompressed_size);
+        decompressed = Lz4Decompress(src, src_size, std::move(dst), job.decompressed_size);
+        if (! decompressed) return false;
+        src      = (const char*)decompressed.get();
+        src_size = job.decompressed_size;
+    }
+    if (job.container) {
+        int32_t w, h, n;
+        auto* data = stbi_load_from_memory((const unsigned char*)src, src_size, &w, &h, &n, 4);
+        if (data == nullptr) {
+            LOG_ERROR("load image container of \"%s\" failed", path.c_str());
+            return false;
+        }
+        mipmap.data = ImageDataPtr((uint8_t*)data, [](uint8_t* data) {
+            stbi_image_free((unsigned char*)data);
+        });
+        src_size    = w * h * 4;
+    } else if (decompressed) {
+        mipmap.data = std::move(decompressed);
+    } else {
+        mipmap.data = AllocateImageData(allocator, (usize)src_size);
+        std::copy(src, src + src_size, mipmap.data.get());
+    }
+    mipmap.size = src_size * (i32)sizeof(uint8_t);
+    return true;
+}
+
+// rows of blocks per encode job, big mipmaps are split so they don't serialize the pool
+constexpr u32 TRANSCODE_BAND_ROWS { 64 };
+
+usize LargestSlotPixels(const Image& img) {
+    usize pixels { 0 };
+    for (const auto& slot : img.slots) pixels = std::max(pixels, (usize)slot.width * (usize)slot.height);
+    return pixels;
+}
+
+// decoded rgba8 mipmaps to bc1 if opaque, otherwise bc3
+// false if over the error limit, the image is unchanged then
+bool TranscodeBC(Image& img, const ImageTranscode& opt, IImageDataAllocator* allocator,
+                 const std::string& path) {
+    WP_TRACE_SCOPE("tex transcode");
+    bool opaque { true };
+    for (const auto& slot : img.slots) {
+        if (slot.mipmaps.empty()) return false;
+        for (const auto& mipmap : slot.mipmaps) {
+            if (mipmap.size < (isize)mipmap.width * mipmap.height * 4) return false;
+        }
+        const auto& mip0 = slot.mipmaps[0];
+        opaque           = opaque && utils::bc::IsOpaque(mip0.data.get(),
+                                               (usize)mip0.width * (usize)mip0.height);
+    }
+
+    usize block_size = opaque ? utils::bc::BC1_BLOCK_SIZE : utils::bc::BC3_BLOCK_SIZE;
+    auto  encode     = opaque ? utils::bc::EncodeBC1 : utils::bc::EncodeBC3;
+
+    struct Band {
+        const uint8_t* src;
+        u32            width, height;
+        uint8_t*       dst;
+    };
+    std::vector<ImageDataPtr> outputs;
+    std::vector<Band>         bands;
+    usize                     pixels { 0 };
+    for (const auto& slot : img.slots) {
+        for (const auto& mipmap : slot.mipmaps) {
+            u32   w = (u32)mipmap.width, h = (u32)mipmap.height;
+            usize size = utils::bc::CompressedSize(w, h, block_size);
+            auto& out  = outputs.emplace_back(AllocateImageData(allocator, size));
+            pixels += (usize)w * h;
+            for (u32 y = 0; y < h; y += TRANSCODE_BAND_ROWS * 4) {
+                bands.push_back(Band {
+                    .src    = mipmap.data.get() + (usize)y * w * 4,
+                    .width  = w,
+                    .height = std::min(h - y, TRANSCODE_BAND_ROWS * 4),
+                    .dst    = out.get() + utils::bc::CompressedSize(w, y, block_size),
+                });
+            }
+        }
+    }
+
+    auto&                              pool = utils::ThreadPool::Global();
+    std::vector<std::future<uint64_t>> results;
+    results.reserve(bands.size());
+    for (const auto& band : bands) {
+        results.push_back(pool.Post([&band, encode]() {
+            return encode(band.src, band.width, band.height, band.dst);
+        }));
+    }
+    uint64_t err { 0 };
+    for (auto& r : results) {
+        pool.Wait(r);
+        err += r.get();
+    }
+
+    float mse = (float)((double)err / (double)(pixels * (opaque ? 3u : 4u)));
+    if (mse > opt.max_error) {
+        LOG_INFO("tex \"%s\" kept as rgba8, bc error %.1f", path.c_str(), mse);
+        return false;
+    }
+
+    usize i { 0 };
+    for (auto& slot : img.slots) {
+        for (auto& mipmap : slot.mipmaps) {
+            mipmap.size = (isize)utils::bc::CompressedSize(
+                (u32)mipmap.width, (u32)mipmap.height, block_size);
+            mipmap.data = std::move(outputs[i++]);
+        }
+    }
+    img.header.format = opaque ? TextureFormat::BC1 : TextureFormat::BC3;
+    return true;
+}
+
+void ReadSpriteFrames(fs::BinaryReader& file, WPTexIndex& index) {
+    auto& header = index.header;
+    // sprite pos
+    int32_t texs       = ReadTexVesion(file);
+    int32_t framecount = file.ReadInt32();
+    if (texs > 3) {
+        LOG_ERROR("Unkown texs version");
+    }
+    if (texs == 3) {
+        i32 width  = file.ReadInt32();
+        i32 height = file.ReadInt32();
+        (void)width;
+        (void)height;
+    }
+
+    for (int32_t i = 0; i < framecount; i++) {
+        SpriteFrame sf;
+        sf.imageId = file.ReadInt32();
+        if (sf.imageId < 0 || (usize)sf.imageId >= index.slots.size() ||
+            index.slots[(usize)sf.imageId].empty()) {
+            LOG_ERROR("get wrong imageid %d", sf.imageId);
+            break;
+        }
+        const auto& mip0         = index.slots[(usize)sf.imageId][0];
+        float       spriteWidth  = (float)mip0.width;
+        float       spriteHeight = (float)mip0.height;
+
+        sf.frametime = file.ReadFloat();
+        if (texs == 1) {
+            sf.x        = (float)file.ReadInt32() / spriteWidth;
+            sf.y        = (float)file.ReadInt32() / spriteHeight;
+            sf.xAxis[0] = (float)file.ReadInt32();
+            sf.xAxis[1] = (float)file.ReadInt32();
+            sf.yAxis[0] = (float)file.ReadInt32();
+            sf.yAxis[1] = (float)file.ReadInt32();
+        } else {
+            sf.x        = file.ReadFloat() / spriteWidth;
+            sf.y        = file.ReadFloat() / spriteHeight;
+            sf.xAxis[0] = file.ReadFloat();
+            sf.xAxis[1] = file.ReadFloat();
+            sf.yAxis[0] = file.ReadFloat();
+            sf.yAxis[1] = file.ReadFloat();
+        }
+        sf.width  = (float)std::sqrt(std::pow(sf.xAxis[0], 2) + std::pow(sf.xAxis[1], 2));
+        sf.height = (float)std::sqrt(std::pow(sf.yAxis[0], 2) + std::pow(sf.yAxis[1], 2));
+        sf.xAxis[0] /= spriteWidth;
+        sf.xAxis[1] /= spriteWidth;
+        sf.yAxis[0] /= spriteHeight;
+        sf.yAxis[1] /= spriteHeight;
+        sf.rate = sf.height / sf.width;
+        header.spriteAnim.AppendFrame(sf);
+    }
+}
+
+// header, mipmap table and sprite frames, payloads are skipped
+void ScanTex(fs::BinaryReader& file, WPTexIndex& index, const std::string& path) {
+    auto& header = index.header;
+    LoadHeader(file, header);
+    if (header.count < 0 || ! file.ok() || file.Size() > std::numeric_limits<u32>::max()) return;
+    index.file_size   = (u32)file.Size();
+    index.header_size = (u32)file.Tell();
+
+    index.slots.resize((usize)header.count);
+    for (usize i_image = 0; i_image < index.slots.size(); i_image++) {
+        auto& mipmaps      = index.slots[i_image];
+        i32   mipmap_count = file.ReadInt32();
+        if (mipmap_count < 0 || ! file.ok()) return;
+        mipmaps.resize((usize)mipmap_count);
+        for (usize i_mipmap = 0; i_mipmap < mipmaps.size(); i_mipmap++) {
+            auto& mipmap  = mipmaps[i_mipmap];
+            mipmap.width  = file.ReadInt32();
+            mipmap.height = file.ReadInt32();
+            if (i_mipmap == 0) {
+                if (header.isSprite) {
+                    header.mipmap_pow2 = algorism::IsPowOfTwo((u32)(mipmap.width * mipmap.height));
+                } else if (i_image == 0) {
+                    SetHeaderPow2(header, mipmap.width, mipmap.height);
+                }
+            }
+            // check compress
+            if (header.extraHeader["texb"].val > 1) {
+                mipmap.lz4               = file.ReadInt32() == 1;
+                mipmap.decompressed_size = file.ReadInt32();
+            }
+            mipmap.src_size = file.ReadInt32();
+            mipmap.offset   = (u32)file.Tell();
+            if (mipmap.src_size <= 0 || mipmap.width <= 0 || mipmap.height <= 0 ||
+                mipmap.decompressed_size < 0 || ! file.Skip((usize)mipmap.src_size)) {
+                LOG_ERROR("tex file \"%s\" truncated", path.c_str());
+                return;
+            }
+        }
+    }
+    index.complete = true;
+    if (header.isSprite) ReadSpriteFrames(file, index);
+}
+
+// index scanned from this tex, a tex edited in a scene dir doesn't change the pkg id
+bool IndexMatches(const WPTexIndex& index, std::span<const std::byte> data, usize file_size) {
+    if (index.file_size != file_size || index.header_size > data.size()) return false;
+    return index.header_sha == utils::genSha1({ (const char*)data.data(), index.header_size });
+}
+
+/*
+    tex index of a scene, in the cache folder
+    TIDX0002
+    pkg id, u32 entry count
+    entry: name, u32 file size, header size, header sha, header, sprite frames, slots
+        slot: u32 mipmap count
+            mipmap: i32 width, height, lz4, decompressed size, src size, u32 offset
+    strings are u32 length and bytes, floats are stored as their bits
+*/
+void WriteString(fs::IBinaryStreamW& file, std::string_view str) {
+    file.WriteUint32((u32)str.size());
+    file.Write(str.data(), str.size());
+}
+
+std::string ReadString(fs::BinaryReader& file) {
+    auto bytes = file.ReadBytes(file.ReadUint32());
+    return std::string((const char*)bytes.data(), bytes.size());
+}
+
+void WriteFloat(fs::IBinaryStreamW& file, float x) { file.WriteUint32(std::bit_cast<u32>(x)); }
+
+void WriteIndexEntry(fs::IBinaryStreamW& file, std::string_view name, const WPTexIndex& index) {
+    const auto& h = index.header;
+    WriteString(file, name);
+    file.WriteUint32(index.file_size);
+    file.WriteUint32(index.header_size);
+    WriteString(file, index.header_sha);
+    for (i32 x : { h.width,
+                   h.height,
+                   h.mapWidth,
+                   h.mapHeight,
+                   (i32)h.mipmap_larger,
+                   (i32)h.mipmap_pow2,
+                   (i32)h.type,
+                   (i32)h.format,
+                   h.count,
+                   (i32)h.isSprite,
+                   (i32)h.sample.wrapS,
+                   (i32)h.sample.wrapT,
+                   (i32)h.sample.magFilter,
+                   (i32)h.sample.minFilter })
+        file.WriteInt32(x);
+    file.WriteUint32((u32)h.extraHeader.size());
+    for (const auto& [key, extra] : h.extraHeader) {
+        WriteString(file, key);
+        file.WriteInt32(extra.val);
+    }
+
+    const auto& frames = h.spriteAnim.frames();
+    file.WriteUint32((u32)frames.size());
+    for (const auto& f : frames) {
+        file.WriteInt32(f.imageId);
+        for (float x : { f.frametime,
+                         f.x,
+                         f.y,
+                         f.width,
+                         f.height,
+                         f.rate,
+                         f.xAxis[0],
+                         f.xAxis[1],
+                         f.yAxis[0],
+                         f.yAxis[1] })
+            WriteFloat(file, x);
+    }
+
+    file.WriteUint32((u32)index.slots.size());
+    for (const auto& slot : index.slots) {
+        file.WriteUint32((u32)slot.size());
+        for (const auto& m : slot) {
+            file.WriteInt32(m.width);
+            file.WriteInt32(m.height);
+            file.WriteInt32(m.lz4);
+            file.WriteInt32(m.decompressed_size);
+            file.WriteInt32(m.src_size);
+            file.WriteUint32(m.offset);
+        }
+    }
+}
+
+bool ReadIndexEntry(fs::BinaryReader& file, std::string& name, WPTexIndex& index) {
+    auto& h           = index.header;
+    name              = ReadString(file);
+    index.file_size   = file.ReadUint32();
+    index.header_size = file.ReadUint32();
+    index.header_sha  = ReadString(file);
+
+    h.width               = file.ReadInt32();
+    h.height              = file.ReadInt32();
+    h.mapWidth            = file.ReadInt32();
+    h.mapHeight           = file.ReadInt32();
+    h.mipmap_larger       = file.ReadInt32() != 0;
+    h.mipmap_pow2         = file.ReadInt32() != 0;
+    h.type                = (ImageType)file.ReadInt32();
+    h.format              = (TextureFormat)file.ReadInt32();
+    h.count               = file.ReadInt32();
+    h.isSprite            = file.ReadInt32() != 0;
+    h.sample.wrapS        = (TextureWrap)file.ReadInt32();
+    h.sample.wrapT        = (TextureWrap)file.ReadInt32();
+    h.sample.magFilter    = (TextureFilter)file.ReadInt32();
+    h.sample.minFilter    = (TextureFilter)file.ReadInt32();
+    u32 extra_count       = file.ReadUint32();
+    for (u32 i = 0; i < extra_count && file.ok(); i++) {
+        auto key               = ReadString(file);
+        h.extraHeader[key].val = file.ReadInt32();
+    }
+
+    u32 frame_count = file.ReadUint32();
+    for (u32 i = 0; i < frame_count && file.ok(); i++) {
+        SpriteFrame f;
+        f.imageId   = file.ReadInt32();
+        f.frametime = file.ReadFloat();
+        f.x         = file.ReadFloat();
+        f.y         = file.ReadFloat();
+        f.width     = file.ReadFloat();
+        f.height    = file.ReadFloat();
+        f.rate      = file.ReadFloat();
+        f.xAxis[0]  = file.ReadFloat();
+        f.xAxis[1]  = file.ReadFloat();
+        f.yAxis[0]  = file.ReadFloat();
+        f.yAxis[1]  = file.ReadFloat();
+        h.spriteAnim.AppendFrame(f);
+    }
+
+    u32 slot_count = file.ReadUint32();
+    if (! file.ok() || slot_count > file.Remaining()) return false;
+    index.slots.resize(slot_count);
+    for (auto& slot : index.slots) {
+        u32 mipmap_count = file.ReadUint32();
+        if (! file.ok() || mipmap_count > file.Remaining()) return false;
+        slot.resize(mipmap_count);
+        for (auto& m : slot) {
+            m.width             = file.ReadInt32();
+            m.height            = file.ReadInt32();
+            m.lz4               = file.ReadInt32() != 0;
+            m.decompressed_size = file.ReadInt32();
+            m.src_size          = file.ReadInt32();
+            m.offset            = file.ReadUint32();
+        }
+    }
+    index.complete = file.ok();
+    return file.ok();
+}
+
 } // namespace
 
 std::shared_ptr<Image> WPTexImageParser::Parse(const std::string& name) {
@@ -128,173 +708,237 @@ std::shared_ptr<Image> WPTexImageParser::Parse(const std::string& name) {
     // std::ifstream file = fs::GetFileFstream(vfs, path);
     auto pfile = m_vfs->Open(path);
     if (! pfile) return nullptr;
-    auto& file     = *pfile;
-    auto  startpos = file.Tell();
-    LoadHeader(file, img.header);
+    fs::StreamReader file(pfile);
+
+    auto index = findIndex(name);
+    if (! index || ! IndexMatches(*index, file.Data(), file.Size()))
+        index = scanIndex(name, file.Data());
+    if (! index->complete) return nullptr;
+    img.header = index->header;
+
+    // pre-decoded by the repack tool, next to the tex
+    if (std::string decoded_path = "/assets/materials/" + name + "." TEX_CACHE_SUFFIX;
+        m_vfs->Contains(decoded_path)) {
+        if (LoadCachedImage(*m_vfs, decoded_path, img)) return img_ptr;
+        img.slots.clear();
+    }
 
-    // image
-    i32 _image_count = img.header.count;
-    if (_image_count < 0) return nullptr;
-    usize image_count = (usize)_image_count;
+    // nearest filtered textures are usually pixel art, block artifacts would show
+    bool transcode = m_transcode.enabled() && img.header.format == TextureFormat::RGBA8 &&
+                     img.header.sample.minFilter != TextureFilter::NEAREST;
+    std::string options;
+    if (transcode) {
+        options = "bc:" + std::to_string(m_transcode.min_pixels) + ":" +
+                  std::to_string(m_transcode.max_error);
+    }
+
+    std::string cache_path;
+    if (! m_scene_id.empty() && m_vfs->IsMounted("cache")) {
+        cache_path = GetCachePath(m_scene_id, GenCacheKey(m_pkg_id,
+                                                           path,
+                                                           options,
+                                                           file.Size(),
+                                                           file.Data().first(index->header_size)));
+        if (m_vfs->Contains(cache_path) && LoadCachedImage(*m_vfs, cache_path, img, transcode))
+            return img_ptr;
+        img.slots.clear();
+    }
 
-    img.slots.resize(image_count);
-    for (usize i_image = 0; i_image < image_count; i_image++) {
+    bool container = img.header.extraHeader["texb"].val == 3 && img.header.type != ImageType::UNKNOWN;
+
+    // decoded by an earlier load, maybe of another wallpaper using the same tex
+    // only image containers, lz4 is cheap to redo and goes straight to the data allocator
+    auto&       store = utils::ContentStore::Global();
+    std::string store_key;
+    if (store.Budget() > 0 && container) {
+        auto raw  = file.Data();
+        store_key = "tex:" + utils::genSha1({ (const char*)raw.data(), raw.size() }) + options;
+        if (auto shared = store.Get<Image>(store_key); shared) {
+            ShareImageData(shared, img);
+            return img_ptr;
+        }
+    }
+
+    // mipmap table from the index, data is decoded after
+    std::vector<MipmapJob> jobs;
+    bool                   decoded { false };
+
+    img.slots.resize(index->slots.size());
+    for (usize i_image = 0; i_image < img.slots.size(); i_image++) {
         auto& img_slot = img.slots[i_image];
-        auto& mipmaps  = img_slot.mipmaps;
-
-        i32   _mipmap_count = file.ReadInt32();
-        usize mipmap_count  = (usize)_mipmap_count;
-        mipmaps.resize(mipmap_count);
-        // load image
-        for (usize i_mipmap = 0; i_mipmap < mipmap_count; i_mipmap++) {
-            auto& mipmap  = mipmaps.at(i_mipmap);
-            mipmap.width  = file.ReadInt32();
-            mipmap.height = file.ReadInt32();
+        auto& entries  = index->slots[i_image];
+        img_slot.mipmaps.resize(entries.size());
+        for (usize i_mipmap = 0; i_mipmap < entries.size(); i_mipmap++) {
+            const auto& entry  = entries[i_mipmap];
+            auto&       mipmap = img_slot.mipmaps[i_mipmap];
+            if (entry.offset > file.Size() || (usize)entry.src_size > file.Size() - entry.offset) {
+                LOG_ERROR("tex file \"%s\" truncated", path.c_str());
+                return nullptr;
+            }
+            mipmap.width       = entry.width;
+            mipmap.height      = entry.height;
             if (i_mipmap == 0) {
                 img_slot.width  = mipmap.width;
                 img_slot.height = mipmap.height;
                 SetHeaderPow2(img.header, mipmap.width, mipmap.height);
             }
 
-            bool    LZ4_compressed    = false;
-            int32_t decompressed_size = 0;
-            // check compress
-            if (img.header.extraHeader["texb"].val > 1) {
-                LZ4_compressed    = file.ReadInt32() == 1;
-                decompressed_size = file.ReadInt32();
-            }
-
-            i32 src_size = file.ReadInt32();
-            if (src_size <= 0 || mipmap.width <= 0 || mipmap.height <= 0 || decompressed_size < 0)
-                return nullptr;
+            // view into the file, no copy
+            MipmapJob job { .mipmap            = &mipmap,
+                            .src               = (const char*)file.Data().data() + entry.offset,
+                            .src_size          = entry.src_size,
+                            .lz4               = entry.lz4,
+                            .decompressed_size = entry.decompressed_size,
+                            .container         = container };
+            decoded = decoded || job.lz4 || job.container;
+            jobs.push_back(job);
+        }
+    }
 
-            char* result;
-            result = new char[(usize)src_size];
-            file.Read(result, (usize)src_size);
-
-            // is LZ4 compress
-            if (LZ4_compressed) {
-                char* decompressed_char = Lz4Decompress(result, src_size, decompressed_size);
-                src_size                = decompressed_size;
-                if (decompressed_char != nullptr) {
-                    delete[] result;
-                    result = decompressed_char;
-                } else {
-                    LOG_ERROR("lz4 decompress failed");
-                    delete[] result;
-                    return nullptr;
-                }
-            }
-            // is image container
-            if (img.header.extraHeader["texb"].val == 3 && img.header.type != ImageType::UNKNOWN) {
-                int32_t w, h, n;
-                auto*   data =
-                    stbi_load_from_memory((const unsigned char*)result, src_size, &w, &h, &n, 4);
-                mipmap.data = ImageDataPtr((uint8_t*)data, [](uint8_t* data) {
-                    stbi_image_free((unsigned char*)data);
-                });
-                src_size    = w * h * 4;
-            } else {
-                mipmap.data = ImageDataPtr(new uint8_t[(usize)src_size], [](uint8_t* data) {
-                    delete[] data;
-                });
-                std::copy(result, result + src_size, mipmap.data.get());
-            }
-            mipmap.size = src_size * (i32)sizeof(uint8_t);
-            delete[] result;
+    // mipmaps and slots are independent, decode them on the pool
+    // plain copies are not worth a job
+    bool ok { true };
+    if (decoded && jobs.size() > 1) {
+        auto&                          pool = utils::ThreadPool::Global();
+        std::vector<std::future<bool>> results;
+        results.reserve(jobs.size());
+        for (const auto& job : jobs) {
+            results.push_back(pool.Post([&job, &path, this]() {
+                return DecodeMipmap(job, path, m_data_allocator);
+            }));
+        }
+        for (auto& r : results) {
+            pool.Wait(r);
+            ok = r.get() && ok;
         }
+    } else {
+        for (const auto& job : jobs) ok = DecodeMipmap(job, path, m_data_allocator) && ok;
+    }
+    if (! ok) return nullptr;
+
+    // the store outlives the renderer, images put there must not hold device memory
+    auto* allocator  = store_key.empty() ? m_data_allocator : nullptr;
+    bool  encode     = transcode && LargestSlotPixels(img) >= m_transcode.min_pixels;
+    bool  transcoded = encode && TranscodeBC(img, m_transcode, allocator, path);
+    // cached even if kept as rgba8, to not encode again on every load
+    bool save = decoded || encode;
+    decoded   = decoded || transcoded;
+
+    img.header.extraHeader["decoded"].val = decoded;
+    if (decoded && ! store_key.empty()) {
+        store.Put<Image>(store_key, img_ptr, (usize)ImageDataSize(img));
+    }
+    // renamed over the old file, other loads may still read a mapping of it
+    if (save && ! cache_path.empty()) {
+        auto tmp_path = fs::TempPath(cache_path);
+        bool saved { false };
+        if (auto cache_file = m_vfs->OpenW(tmp_path); cache_file) {
+            saved = SaveCachedImage(*cache_file, img);
+        }
+        if (saved) m_vfs->Rename(tmp_path, cache_path);
     }
     return img_ptr;
 }
 
+usize WPTexImageParser::DecodedSize(const Image& img) { return CachedImageSize(img); }
+
+bool WPTexImageParser::WriteDecoded(const Image& img, fs::IBinaryStreamW& file) {
+    return SaveCachedImage(file, img);
+}
+
 ImageHeader WPTexImageParser::ParseHeader(const std::string& name) {
-    ImageHeader header;
     std::string path  = "/assets/materials/" + name + ".tex";
     auto        pfile = m_vfs->Open(path);
-    if (! pfile) return header;
-    auto& file = *pfile;
-
-    LoadHeader(file, header);
-    if (header.count < 0) return header;
-
-    usize image_count = (usize)header.count;
-
-    // load sprite info
-    if (header.isSprite) {
-        // bypass image data, store width and height
-        std::vector<std::vector<float>> imageDatas(image_count);
-        for (usize i_image = 0; i_image < image_count; i_image++) {
-            int mipmap_count = file.ReadInt32();
-            for (int32_t i_mipmap = 0; i_mipmap < mipmap_count; i_mipmap++) {
-                int32_t width  = file.ReadInt32();
-                int32_t height = file.ReadInt32();
-                if (i_mipmap == 0) {
-                    imageDatas.at(i_image) = { (float)width, (float)height };
-                    header.mipmap_pow2     = algorism::IsPowOfTwo((u32)(width * height));
-                }
-                if (header.extraHeader["texb"].val > 1) {
-                    int32_t LZ4_compressed    = file.ReadInt32();
-                    int32_t decompressed_size = file.ReadInt32();
-                    (void)LZ4_compressed;
-                    (void)decompressed_size;
-                }
-                long src_size = file.ReadInt32();
-                file.SeekCur(src_size);
-            }
-        }
-        // sprite pos
-        int32_t texs       = ReadTexVesion(file);
-        int32_t framecount = file.ReadInt32();
-        if (texs > 3) {
-            LOG_ERROR("Unkown texs version");
-        }
-        if (texs == 3) {
-            i32 width  = file.ReadInt32();
-            i32 height = file.ReadInt32();
-            (void)width;
-            (void)height;
+    if (! pfile) return {};
+
+    // only the header bytes are read to check the index
+    if (auto index = findIndex(name); index && pfile->Usize() == index->file_size) {
+        std::span<const std::byte> data = pfile->Data();
+        std::vector<std::byte>     header;
+        if (data.empty()) {
+            header.resize(index->header_size);
+            header.resize(pfile->Read(header.data(), header.size()));
+            data = header;
         }
+        if (IndexMatches(*index, data, index->file_size)) return index->header;
+    }
+    fs::StreamReader file(pfile);
+    return scanIndex(name, file.Data())->header;
+}
 
-        for (int32_t i = 0; i < framecount; i++) {
-            SpriteFrame sf;
-            sf.imageId = file.ReadInt32();
-            if (sf.imageId < 0) {
-                LOG_ERROR("get neg imageid");
-            }
-            float spriteWidth  = imageDatas.at((usize)sf.imageId)[0];
-            float spriteHeight = imageDatas.at((usize)sf.imageId)[1];
-
-            sf.frametime = file.ReadFloat();
-            if (texs == 1) {
-                sf.x        = (float)file.ReadInt32() / spriteWidth;
-                sf.y        = (float)file.ReadInt32() / spriteHeight;
-                sf.xAxis[0] = (float)file.ReadInt32();
-                sf.xAxis[1] = (float)file.ReadInt32();
-                sf.yAxis[0] = (float)file.ReadInt32();
-                sf.yAxis[1] = (float)file.ReadInt32();
-            } else {
-                sf.x        = file.ReadFloat() / spriteWidth;
-                sf.y        = file.ReadFloat() / spriteHeight;
-                sf.xAxis[0] = file.ReadFloat();
-                sf.xAxis[1] = file.ReadFloat();
-                sf.yAxis[0] = file.ReadFloat();
-                sf.yAxis[1] = file.ReadFloat();
-            }
-            sf.width  = (float)std::sqrt(std::pow(sf.xAxis[0], 2) + std::pow(sf.xAxis[1], 2));
-            sf.height = (float)std::sqrt(std::pow(sf.yAxis[0], 2) + std::pow(sf.yAxis[1], 2));
-            sf.xAxis[0] /= spriteWidth;
-            sf.xAxis[1] /= spriteWidth;
-            sf.yAxis[0] /= spriteHeight;
-            sf.yAxis[1] /= spriteHeight;
-            sf.rate = sf.height / sf.width;
-            header.spriteAnim.AppendFrame(sf);
+// textures only loaded by the renderer are scanned after the scene parse
+WPTexImageParser::~WPTexImageParser() { SaveIndex(); }
+
+std::string WPTexImageParser::indexPath() const {
+    return std::string("/cache/") + m_scene_id + "/" TEX_INDEX_FILE;
+}
+
+std::shared_ptr<const WPTexIndex> WPTexImageParser::findIndex(const std::string& name) {
+    std::lock_guard lock(m_index_mutex);
+    if (! m_index_loaded) loadIndex();
+    auto it = m_index.find(name);
+    return it == m_index.end() ? nullptr : it->second;
+}
+
+std::shared_ptr<const WPTexIndex> WPTexImageParser::scanIndex(const std::string&         name,
+                                                              std::span<const std::byte> data) {
+    auto             index = std::make_shared<WPTexIndex>();
+    fs::BinaryReader file(data);
+    ScanTex(file, *index, "/assets/materials/" + name + ".tex");
+    if (index->header_size <= data.size())
+        index->header_sha =
+            utils::genSha1({ (const char*)data.data(), (usize)index->header_size });
+
+    std::lock_guard lock(m_index_mutex);
+    m_index[name] = index;
+    m_index_dirty = m_index_dirty || index->complete;
+    return index;
+}
+
+void WPTexImageParser::loadIndex() {
+    m_index_loaded = true;
+    if (m_scene_id.empty() || ! m_vfs->IsMounted("cache")) return;
+    std::string path = indexPath();
+    if (! m_vfs->Contains(path)) return;
+    auto pfile = m_vfs->OpenMapped(path);
+    if (! pfile) return;
+    fs::BinaryReader file(pfile->Data());
+
+    // version 1 has no header sha, rescanned
+    if (i32 version = ReadTexIndexVesion(file); version != 2) {
+        if (version != 1) LOG_ERROR("tex index \"%s\" is broken", path.c_str());
+        return;
+    }
+    // written for an older pkg, rescan everything
+    if (ReadString(file) != m_pkg_id) return;
+
+    u32 count = file.ReadUint32();
+    for (u32 i = 0; i < count && file.ok(); i++) {
+        std::string name;
+        auto        index = std::make_shared<WPTexIndex>();
+        if (! ReadIndexEntry(file, name, *index)) {
+            LOG_ERROR("tex index \"%s\" is broken", path.c_str());
+            m_index.clear();
+            return;
         }
-    } else {
-        i32 mipmap_count = file.ReadInt32();
-        (void)mipmap_count;
-        i32 width  = file.ReadInt32();
-        i32 height = file.ReadInt32();
-        SetHeaderPow2(header, width, height);
+        m_index[name] = std::move(index);
+    }
+}
+
+bool WPTexImageParser::SaveIndex() {
+    std::lock_guard lock(m_index_mutex);
+    if (! m_index_dirty || m_scene_id.empty() || ! m_vfs->IsMounted("cache")) return false;
+    auto file = m_vfs->OpenW(indexPath());
+    if (! file) return false;
+
+    u32 count { 0 };
+    for (const auto& [name, index] : m_index) count += index->complete;
+    WriteTexIndexVesion(*file, 2);
+    WriteString(*file, m_pkg_id);
+    file->WriteUint32(count);
+    for (const auto& [name, index] : m_index) {
+        if (index->complete) WriteIndexEntry(*file, name, *index);
     }
-    return header;
+    m_index_dirty = false;
+    return true;
 }
@@ -1,19 +1,53 @@
 #pragma once
+#include <memory>
+#include <mutex>
+
 #include "Interface/IImageParser.h"
 #include "Fs/VFS.h"
+#include "Core/MapSet.hpp"
 
 namespace wallpaper
 {
 
+struct WPTexIndex;
+
 class WPTexImageParser : public IImageParser {
 public:
     WPTexImageParser(fs::VFS* vfs): m_vfs(vfs) {}
-    virtual ~WPTexImageParser() = default;
+    // decoded images are cached in /cache/<scene_id> when mounted
+    // pkg_id should change whenever the pkg content does
+    WPTexImageParser(fs::VFS* vfs, std::string_view scene_id, std::string_view pkg_id)
+        : m_vfs(vfs), m_scene_id(scene_id), m_pkg_id(pkg_id) {}
+    virtual ~WPTexImageParser();
 
     std::shared_ptr<Image> Parse(const std::string&) override;
     ImageHeader            ParseHeader(const std::string&) override;
 
+    // decoded layout of the disk cache, also read from "<name>.texc" next to the tex
+    // header.extraHeader["decoded"] is set by Parse if lz4 or an image container was decoded
+    static usize DecodedSize(const Image&);
+    static bool  WriteDecoded(const Image&, fs::IBinaryStreamW&);
+
+    // each tex is scanned once for its header, mipmap table and sprite frames
+    // the index is loaded from /cache/<scene_id> on first use, saved by this if changed
+    // and on destruction
+    bool SaveIndex();
+
 private:
-    fs::VFS* m_vfs;
+    std::shared_ptr<const WPTexIndex> findIndex(const std::string& name);
+    std::shared_ptr<const WPTexIndex> scanIndex(const std::string& name,
+                                                std::span<const std::byte> data);
+    void                              loadIndex();
+    std::string                       indexPath() const;
+
+    fs::VFS*    m_vfs;
+    std::string m_scene_id;
+    std::string m_pkg_id;
+
+    // Parse runs on the worker pool
+    std::mutex                                       m_index_mutex;
+    bool                                             m_index_loaded { false };
+    bool                                             m_index_dirty { false };
+    StringHashMap<std::shared_ptr<const WPTexIndex>> m_index;
 };
 } // namespace wallpaper
@@ -11,6 +11,7 @@ constexpr std::string_view OPT_GRAPHVIZ    = "--graphviz";
 constexpr std::string_view OPT_FPS         = "--fps";
 constexpr std::string_view OPT_RESOLUTION  = "--resolution";
 constexpr std::string_view OPT_CACHE_PATH  = "--cache-path";
+constexpr std::string_view OPT_TRACE       = "--trace";
 
 struct Resolution {
 	uint w;
@@ -50,6 +51,12 @@ void setAndParseArg(argparse::ArgumentParser& arg, int argc, char** argv) {
         .nargs(1)
         .append();
 
+    arg.add_argument("-T", OPT_TRACE)
+        .help("record a chrome trace-event json, written on exit")
+        .default_value(std::string())
+        .nargs(1)
+        .append();
+
     arg.add_argument("-R", OPT_RESOLUTION)
         .help("Set the resolution, eg. 1920x1080")
         .default_value(Resolution{1280, 720})
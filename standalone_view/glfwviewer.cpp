@@ -94,6 +94,9 @@ int main(int argc, char** argv) {
     if (cache_path.empty()) cache_path = wallpaper::platform::GetCachePath("wescene-renderer");
     psw->setPropertyString(wallpaper::PROPERTY_CACHE_PATH, cache_path);
 
+    std::string trace_path = program.get<std::string>(OPT_TRACE);
+    if (! trace_path.empty()) psw->setPropertyString(wallpaper::PROPERTY_TRACE_FILE, trace_path);
+
     glfwSetWindowUserPointer(window, &data);
 
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);